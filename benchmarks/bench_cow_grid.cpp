@@ -0,0 +1,83 @@
+// Times cloning a grid and writing a few cells, as a search branch does
+#include "cow_grid.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+using namespace cycles;
+
+namespace {
+
+template <class F> double microsecondsPerCall(int calls, F &&f) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; ++i) {
+    f();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::micro>(elapsed).count() / calls;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(1234);
+  // A branch moves a few players a few frames: the writes stay close
+  const int writes = 16;
+  const int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::printf("%6s %14s %14s %16s\n", "size", "vector us", "cow us",
+              "cow branches/s");
+  for (int size : {100, 250, 500, 1000}) {
+    std::vector<Id> grid(size * size);
+    for (auto &cell : grid) {
+      cell = rng() % 5 == 0 ? 1 : 0;
+    }
+    CowGrid root(grid, size, size);
+    std::vector<sf::Vector2i> cells(writes);
+    const sf::Vector2i start(rng() % (size - writes), rng() % size);
+    for (int i = 0; i < writes; ++i) {
+      cells[i] = start + sf::Vector2i(i, 0);
+    }
+    const int calls = std::max(10, 20000000 / (size * size));
+    long sink = 0;
+    const auto vector = microsecondsPerCall(calls, [&] {
+      auto branch = grid;
+      for (const auto &cell : cells) {
+        branch[cell.y * size + cell.x] = 2;
+      }
+      sink += branch[start.y * size + start.x];
+    });
+    const auto cow = microsecondsPerCall(calls, [&] {
+      auto branch = root;
+      for (const auto &cell : cells) {
+        branch.set(cell, 2);
+      }
+      sink += branch.get(start);
+    });
+    // Branches of a shared root on every core
+    const auto startTime = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&] {
+        for (int i = 0; i < calls; ++i) {
+          auto branch = root;
+          for (const auto &cell : cells) {
+            branch.set(cell, 2);
+          }
+        }
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    const auto seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - startTime)
+                             .count();
+    std::printf("%6d %14.2f %14.2f %16.0f\n", size, vector, cow,
+                calls * threads / seconds);
+    if (sink == -1) {
+      std::puts("");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+// Times legal move checks with bounds checks and on the padded grid view
+#include "api.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace cycles;
+
+namespace {
+
+template <class F> double nanosecondsPerCell(int cells, int rounds, F &&f) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    f();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         (static_cast<double>(cells) * rounds);
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(1234);
+  const sf::Vector2i steps[] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+  std::printf("%6s %14s %14s\n", "size", "bounds ns", "view ns");
+  for (int size : {100, 250, 500, 1000}) {
+    GameState state;
+    state.gridWidth = size;
+    state.gridHeight = size;
+    state.grid.resize(size * size);
+    for (auto &cell : state.grid) {
+      cell = rng() % 5 == 0 ? 1 : 0;
+    }
+    state.updateOccupancy();
+    const auto view = state.getGridView();
+    const int rounds = std::max(1, 20000000 / (size * size));
+    long sink = 0;
+    // Every cell of the grid, as a flood fill or a search would visit them
+    const auto bounds = nanosecondsPerCell(size * size, rounds, [&] {
+      for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+          for (int d = 0; d < 4; ++d) {
+            const auto next = sf::Vector2i(x, y) + steps[d];
+            sink += state.isInsideGrid(next) && state.isCellEmpty(next);
+          }
+        }
+      }
+    });
+    const auto padded = nanosecondsPerCell(size * size, rounds, [&] {
+      for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+          for (int d = 0; d < 4; ++d) {
+            sink += view.isFree(sf::Vector2i(x, y) + steps[d]);
+          }
+        }
+      }
+    });
+    std::printf("%6d %14.2f %14.2f\n", size, bounds, padded);
+    if (sink == -1) {
+      std::puts("");
+    }
+  }
+  return 0;
+}
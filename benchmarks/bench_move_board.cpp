@@ -0,0 +1,75 @@
+// Times posting moves to the move board against the mutex guarded map the
+// server used before, with several threads posting for 60 players
+#include "server/move_board.h"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace cycles_server;
+
+namespace {
+
+constexpr int players = 60;
+constexpr int postsPerThread = 1'000'000;
+
+// The previous handoff: moves kept per player under a lock
+class LockedMoves {
+  struct Pending {
+    int frame;
+    std::uint8_t sequence;
+    cycles::Direction direction;
+  };
+  std::mutex mutex;
+  std::map<cycles::Id, Pending> moves;
+
+public:
+  void post(cycles::Id id, int frame, cycles::Direction direction,
+            std::uint8_t sequence) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = moves.try_emplace(id, Pending{frame, sequence, direction});
+    if (!inserted && (it->second.frame != frame ||
+                      static_cast<std::int8_t>(sequence - it->second.sequence) >= 0)) {
+      it->second = {frame, sequence, direction};
+    }
+  }
+};
+
+// Nanoseconds per move posted by each of a number of threads
+template <class Target> double time(Target &target, int threads) {
+  std::vector<std::thread> posters;
+  const auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; ++t) {
+    posters.emplace_back([&target, t] {
+      std::uint8_t sequence = 0;
+      for (int i = 0; i < postsPerThread; ++i) {
+        const cycles::Id id = 1 + (i + t * 7) % players;
+        target.post(id, i / 1000, cycles::getDirectionFromValue(i & 3),
+                    sequence++);
+      }
+    });
+  }
+  for (auto &poster : posters) {
+    poster.join();
+  }
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         postsPerThread;
+}
+
+} // namespace
+
+int main() {
+  std::printf("%8s %12s %12s\n", "threads", "board ns", "locked ns");
+  for (int threads : {1, 2, 4, 8}) {
+    MoveBoard board;
+    LockedMoves locked;
+    const auto boardTime = time(board, threads);
+    const auto lockedTime = time(locked, threads);
+    std::printf("%8d %12.1f %12.1f\n", threads, boardTime, lockedTime);
+  }
+  return 0;
+}
@@ -0,0 +1,90 @@
+// Times the territory evaluation on grids of growing size
+#include "territory.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace cycles;
+
+namespace {
+
+// Noise boards scatter single occupied cells, which is the worst case for
+// the row fills; trail boards hold long random walks like a real game
+GameState makeState(int size, int players, bool noise, std::mt19937 &rng) {
+  GameState state;
+  state.gridWidth = size;
+  state.gridHeight = size;
+  state.frameNumber = 0;
+  state.grid.assign(size * size, 0);
+  if (noise) {
+    // Roughly a fifth of the cells are occupied
+    for (auto &cell : state.grid) {
+      cell = rng() % 5 == 0 ? 255 : 0;
+    }
+  } else {
+    for (int trail = 0; trail < 60; ++trail) {
+      sf::Vector2i position(rng() % size, rng() % size);
+      auto direction = getDirectionFromValue(rng() % 4);
+      for (int length = 0; length < size * 2; ++length) {
+        if (rng() % 10 == 0) {
+          direction = getDirectionFromValue(rng() % 4);
+        }
+        const auto next = position + getDirectionVector(direction);
+        if (next.x >= 0 && next.x < size && next.y >= 0 && next.y < size) {
+          position = next;
+        }
+        state.grid[position.y * size + position.x] = 255;
+      }
+    }
+  }
+  for (int p = 0; p < players; ++p) {
+    sf::Vector2i position(rng() % size, rng() % size);
+    state.grid[position.y * size + position.x] = p + 1;
+    state.players.push_back(
+        {"p" + std::to_string(p), sf::Color(), position, Id(p + 1), {}});
+  }
+  state.updateOccupancy();
+  return state;
+}
+
+template <class F> double microsecondsPerCall(int calls, F &&f) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; ++i) {
+    f();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::micro>(elapsed).count() / calls;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(1234);
+  const int players = 8;
+  std::printf("%6s %6s %12s %12s %12s %12s\n", "board", "size", "reset us",
+              "flood us", "distance us", "voronoi us");
+  for (bool noise : {false, true})
+  for (int size : {100, 250, 500, 1000}) {
+    auto state = makeState(size, players, noise, rng);
+    TerritoryEvaluator evaluator;
+    const int calls = std::max(1, 2000000 / (size * size));
+    long sink = 0;
+    const auto reset =
+        microsecondsPerCall(calls, [&] { evaluator.reset(state); });
+    const auto flood = microsecondsPerCall(calls, [&] {
+      sink += evaluator.floodFill(state.players[0].position);
+    });
+    std::vector<sf::Vector2i> heads = state.getPlayerPositions();
+    const auto distance = microsecondsPerCall(
+        calls, [&] { sink += evaluator.distances(heads)[0]; });
+    const auto voronoi =
+        microsecondsPerCall(calls, [&] { sink += evaluator.voronoi()[0]; });
+    std::printf("%6s %6d %12.1f %12.1f %12.1f %12.1f\n",
+                noise ? "noise" : "trails", size, reset, flood, distance,
+                voronoi);
+    if (sink == -1) {
+      std::puts("");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Times moving players with tail lists and with timestamp trails
+#include "rules.h"
+#include "server/game_logic.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace cycles_server;
+
+namespace {
+
+// Turns the first way to a free cell, starting from a random direction
+Direction freeDirection(Game &game, const Configuration &conf,
+                        const Player &player, std::mt19937 &rng) {
+  int value = rng() % 4;
+  for (int turn = 0; turn < 4; ++turn) {
+    const auto next = player.position +
+                      getDirectionVector(cycles::getDirectionFromValue(value));
+    if (next.x >= 0 && next.y >= 0 && next.x < conf.gridWidth &&
+        next.y < conf.gridHeight && game.getCell(next.x, next.y) == 0) {
+      break;
+    }
+    value = (value + 1) % 4;
+  }
+  return cycles::getDirectionFromValue(value);
+}
+
+} // namespace
+
+int main() {
+  Configuration lists("");
+  lists.gridWidth = 1000;
+  lists.gridHeight = 1000;
+  Configuration timestamps = lists;
+  timestamps.timestampTrails = true;
+  const int players = 50;
+  const int frames = 2000;
+  std::printf("%10s %14s %14s\n", "tail", "lists us", "timestamps us");
+  // The maximum tail length grows with the frame number
+  for (int firstFrame : {0, 50000, 500000}) {
+    Game listGame(lists, 1234);
+    Game timestampGame(timestamps, 1234);
+    for (int p = 0; p < players; ++p) {
+      listGame.addPlayer("player" + std::to_string(p));
+      timestampGame.addPlayer("player" + std::to_string(p));
+    }
+    listGame.setFrame(firstFrame);
+    timestampGame.setFrame(firstFrame);
+    std::mt19937 rng(firstFrame);
+    std::chrono::steady_clock::duration listTime{}, timestampTime{};
+    int moved = 0;
+    for (; moved < frames && !listGame.isGameOver(); ++moved) {
+      // Both games stay identical, so they take the same moves
+      std::map<Id, Direction> directions;
+      for (const auto &[id, player] : listGame.getPlayers()) {
+        directions[id] = freeDirection(listGame, lists, player, rng);
+      }
+      auto start = std::chrono::steady_clock::now();
+      listGame.movePlayers(directions);
+      listTime += std::chrono::steady_clock::now() - start;
+      start = std::chrono::steady_clock::now();
+      timestampGame.movePlayers(directions);
+      timestampTime += std::chrono::steady_clock::now() - start;
+      listGame.setFrame(listGame.getFrame() + 1);
+      timestampGame.setFrame(timestampGame.getFrame() + 1);
+    }
+    const auto perFrame = [&](std::chrono::steady_clock::duration time) {
+      return std::chrono::duration<double, std::micro>(time).count() / moved;
+    };
+    std::printf("%10d %14.2f %14.2f\n", cycles::rules::maxTailLength(firstFrame),
+                perFrame(listTime), perFrame(timestampTime));
+  }
+  return 0;
+}
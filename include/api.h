@@ -1,6 +1,9 @@
 #pragma once
+#include "bitboard.h"
+#include "grid_view.h"
 #include "utils.h"
 #include <SFML/Graphics.hpp>
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
@@ -18,10 +21,24 @@ struct Player {
   sf::Color color;  ///< The color of the player
   sf::Vector2i position; ///< The position of the player's head in the grid (in cells)
   Id id; ///< The unique identifier of the player
+  /**
+   * @brief The cells of the player's trail behind its head, newest first
+   *
+   * Once the trail is longer than rules::maxTailLength for the current
+   * frame, the oldest cell is freed every time the player moves.
+   */
+  std::vector<sf::Vector2i> tail;
 };
 
 // Forward declaration for friend declaration in GameState
 class Connection;
+struct GameState;
+bool readFrame(sf::Packet &packet, GameState &state);
+bool readDelta(sf::Packet &packet, GameState &state);
+class SharedFrameBuffer;
+namespace protocol {
+class FrameAssembler;
+}
 
 /**
  * @brief A representation of the state of the game
@@ -35,12 +52,24 @@ struct GameState {
    * Each cell is represented by the unique identifier of the player that
    * occupies it. The value 0 represents an empty cell. The grid is stored in
    * row-major order and has dimensions gridWidth x gridHeight.
+   *
+   * When the server runs in viewport mode the grid only holds a window of
+   * the arena around the player's head, starting at windowOffset; positions
+   * are still given in arena coordinates. See getArenaGrid for the whole
+   * arena.
    */
   std::vector<Id> grid;
 
   int gridWidth;  ///< The width of the grid (in cells)
   int gridHeight; ///< The height of the grid (in cells)
 
+  /// Position in the arena of the first cell of the grid, (0, 0) unless the
+  /// grid is a window
+  sf::Vector2i windowOffset;
+
+  /// Size of the whole arena (in cells), (0, 0) if it is the size of the grid
+  sf::Vector2i arenaSize;
+
   /**
    * @brief A vector with the players in the game
    */
@@ -48,8 +77,41 @@ struct GameState {
 
   int frameNumber; ///< The number of the current frame
 
+  sf::Time serverTime; ///< When the server sent the frame, on the server's clock
+
+  /**
+   * @brief How long the server waits for moves after sending the frame
+   *
+   * Zero if the server does not advertise a deadline.
+   */
+  sf::Time moveBudget;
+
+  /**
+   * @brief How much longer this frame took to arrive than the fastest frame
+   * received so far, an estimate of the time it spent queued on the way
+   */
+  sf::Time transitDelay;
+
   GameState() = default;
 
+  /**
+   * @brief Get the time elapsed since the state was received
+   */
+  sf::Time getElapsedTime() const { return receiveClock.getElapsedTime(); }
+
+  /**
+   * @brief Get the time left before the server stops waiting for the move
+   *
+   * The move still has to travel to the server, so bots should keep a small
+   * margin. Negative once the deadline has passed, and never positive when
+   * the server advertises no deadline.
+   *
+   * @return sf::Time The remaining time
+   */
+  sf::Time getRemainingTime() const {
+    return moveBudget - transitDelay - receiveClock.getElapsedTime();
+  }
+
   /**
    * @brief Get the value of a cell in the grid
    *
@@ -57,7 +119,8 @@ struct GameState {
    * @return Id The identifier of the player occupying the cell (0 if empty)
    */
   Id getGridCell(sf::Vector2i position) const {
-    return grid[position.y * gridWidth + position.x];
+    return grid[(position.y - windowOffset.y) * gridWidth + position.x -
+                windowOffset.x];
   }
 
   /**
@@ -79,10 +142,98 @@ struct GameState {
    * @return false if the position is outside the grid
    */
   bool isInsideGrid(sf::Vector2i position) const {
+    position -= windowOffset;
     return position.x >= 0 && position.x < gridWidth && position.y >= 0 &&
            position.y < gridHeight;
   }
 
+  /**
+   * @brief Get the size of the arena, larger than the grid in viewport mode
+   */
+  sf::Vector2i getArenaSize() const {
+    return arenaSize.x > 0 ? arenaSize : sf::Vector2i(gridWidth, gridHeight);
+  }
+
+  /**
+   * @brief Check if a position is inside the arena
+   */
+  bool isInsideArena(sf::Vector2i position) const {
+    const auto size = getArenaSize();
+    return position.x >= 0 && position.x < size.x && position.y >= 0 &&
+           position.y < size.y;
+  }
+
+  /**
+   * @brief Get the grid of the whole arena
+   *
+   * Every occupied cell belongs to the head or the tail of a player, and
+   * those are always sent, so the cells outside the window are rebuilt
+   * exactly from the players.
+   *
+   * @param arena Receives the arena in row-major order, getArenaSize() cells
+   */
+  void getArenaGrid(std::vector<Id> &arena) const;
+
+  /**
+   * @brief Get the occupancy of the grid, one bit per cell
+   *
+   * Built once when the state is received, so queries on it never allocate.
+   * It covers the grid only, so in viewport mode its coordinates are
+   * relative to windowOffset and the cells outside the window read as
+   * occupied.
+   */
+  const OccupancyBitboard &getOccupancy() const { return occupancy; }
+
+  /**
+   * @brief Get the grid with a border of walls, which needs no bounds checks
+   * for the cells of the grid and their neighbours
+   *
+   * Built once when the state is received, like the occupancy bitboard.
+   */
+  GridView getGridView() const {
+    return GridView(paddedGrid.data(), gridWidth, gridHeight, windowOffset);
+  }
+
+  /**
+   * @brief Rebuild the occupancy bitboard and the padded grid after editing
+   * the grid
+   */
+  void updateOccupancy() {
+    occupancy.build(grid, gridWidth, gridHeight);
+    padGrid(grid, gridWidth, gridHeight, paddedGrid);
+  }
+
+  /**
+   * @brief Get the legal moves of a player
+   *
+   * A move is legal if it leads to a free cell inside the grid. Moves of
+   * other players in the same frame are not taken into account. In
+   * viewport mode the moves of players outside the window are unknown (0).
+   *
+   * @param player The player
+   * @return A mask with bit d set if the direction of value d (see
+   * getDirectionValue) is legal
+   */
+  std::uint8_t getLegalMoves(const Player &player) const {
+    if (!isInsideGrid(player.position)) {
+      return 0;
+    }
+    return occupancy.getFreeNeighbors(player.position - windowOffset);
+  }
+
+  /**
+   * @brief Get the legal moves of every player
+   *
+   * @param moves Receives one mask per player, in the order of players, see
+   * getLegalMoves(const Player &). Its memory is reused between calls.
+   */
+  void getLegalMoves(std::vector<std::uint8_t> &moves) const {
+    moves.resize(players.size());
+    for (std::size_t i = 0; i < players.size(); ++i) {
+      moves[i] = getLegalMoves(players[i]);
+    }
+  }
+
   /**
    * @brief Get the positions of all players
    *
@@ -112,38 +263,128 @@ struct GameState {
 
 private:
   friend Connection;
+  friend bool readFrame(sf::Packet &packet, GameState &state);
+  friend bool readDelta(sf::Packet &packet, GameState &state);
   GameState(sf::Packet &packet);
+  sf::Clock receiveClock;
+  OccupancyBitboard occupancy;
+  std::vector<Id> paddedGrid;
 };
+/**
+ * @brief Time spent by a connection inside its transport calls
+ *
+ * The receive times include waiting for the server to publish the frame, so
+ * they show how much of a frame is left for thinking once a state arrives.
+ */
+struct LatencyStats {
+  sf::Time lastReceive;  ///< Duration of the last call to receiveGameState
+  sf::Time lastSend;     ///< Duration of the last call to sendMove
+  sf::Time maxReceive;   ///< Longest call to receiveGameState
+  sf::Time maxSend;      ///< Longest call to sendMove
+  sf::Time totalReceive; ///< Time spent in all calls to receiveGameState
+  sf::Time totalSend;    ///< Time spent in all calls to sendMove
+  int receives = 0;      ///< Number of game states received
+  int sends = 0;         ///< Number of moves sent
+};
+
 /**
  * @brief A connection to the server. Allows to receive the game state and send
  * the player's moves.
  */
 class Connection {
   std::shared_ptr<sf::TcpSocket> socket;
+  std::shared_ptr<SharedFrameBuffer> sharedMemory;
+  int moveSlot = -1;
+  std::shared_ptr<sf::UdpSocket> udpSocket;
+  std::shared_ptr<protocol::FrameAssembler> assembler;
+  std::vector<std::byte> datagram; ///< Reused by every UDP receive
+  unsigned short serverUdpPort = 0;
+  sf::Uint8 moveSequence = 0;
   int frameNumber = 0;
   int lastFrameSent = -1;
+  int lastFrameReceived = -1;
   std::string playerName;
+  LatencyStats stats;
+  sf::Clock clientClock;
+  sf::Time minClockOffset;
+  bool spectator = false;
+  int spectatorInterval = 0;
+  std::shared_ptr<GameState> deltaBase; ///< Last state, if frames come as deltas
 
 public:
   /**
    * @brief Construct a new Connection object
    *
+   * If the server runs on the same host and publishes its frames in shared
+   * memory, the connection uses the shared frame buffer for game states and
+   * moves, and keeps the TCP socket only for the handshake and to detect
+   * disconnections. Setting the environment variable CYCLES_TRANSPORT to
+   * `udp` requests UDP datagrams for game states and moves instead, and
+   * `tcp` forces the plain TCP transport.
+   *
+   * If the server cannot be reached the connection stays inactive, check
+   * isActive before using it.
+   *
    * @param playerName The name of the player that is trying to connect
    * @return sf::Color The color assigned to the player
    */
   sf::Color connect(std::string playerName);
 
+  /**
+   * @brief Connect to the server as a spectator
+   *
+   * Spectators receive the game states with receiveGameState like players,
+   * but do not take part in the match and cannot send moves. They may join
+   * a match that has already started. The server sends one frame every
+   * frameInterval frames, or less often if it enforces a larger interval
+   * (see getSpectatorInterval), and skips frames for spectators that do not
+   * keep up. With an interval of 1 the spectator also accepts frames sent as
+   * changes to the previous one, which relays use to save bandwidth.
+   *
+   * @param name The name shown in the server's logs
+   * @param frameInterval The number of frames between two game states
+   * @return true if the server accepted the spectator
+   */
+  bool spectate(std::string name, int frameInterval = 1);
+
+  /**
+   * @brief Get the number of frames between two game states received by a
+   * spectator, as granted by the server (0 for players)
+   */
+  int getSpectatorInterval() const { return spectatorInterval; }
+
   /**
    * @brief Send the player's move to the server
    *
    * Can only be called once per frame, after receiving the game state.
-   * Will block until the move is sent.
-   * Will return without doing nothing if the user is trying to send a move
-   * twice in the same frame.
+   * The socket is never switched to blocking mode; the call returns as soon
+   * as the move is handed to the operating system or the timeout expires.
+   * Will return sf::Socket::Done without doing nothing if the user is trying
+   * to send a move twice in the same frame.
    *
    * @param direction The direction of the move
+   * @param timeout The maximum time to wait, sf::Time::Zero waits forever
+   * @return sf::Socket::Status Done if the move was sent, NotReady if the
+   * timeout expired, Disconnected or Error if the connection was lost (the
+   * connection is then inactive)
+   */
+  sf::Socket::Status sendMove(Direction direction,
+                              sf::Time timeout = sf::Time::Zero);
+
+  /**
+   * @brief Receive the game state from the server
+   *
+   * Waits until the game state is received. Can only be called once per
+   * frame.
+   *
+   * @param state Receives the game state
+   * @param timeout The maximum time to wait, sf::Time::Zero waits forever
+   * @return sf::Socket::Status Done if a state was received, NotReady if the
+   * timeout expired, Disconnected or Error if the connection was lost (the
+   * connection is then inactive)
    */
-  void sendMove(Direction direction);
+  sf::Socket::Status receiveGameState(GameState &state,
+                                      sf::Time timeout = sf::Time::Zero);
 
   /**
    * @brief Receive the game state from the server
@@ -151,7 +392,8 @@ public:
    * Will block until the game state is received.
    * Can only be called once per frame.
    *
-   * @return GameState The game state
+   * @return GameState The game state, or an empty state if the connection
+   * was lost
    */
   GameState receiveGameState();
 
@@ -162,6 +404,20 @@ public:
    * @return false if the connection is not active
    */
   bool isActive();
+
+  /**
+   * @brief Get the time spent in the transport calls so far
+   */
+  const LatencyStats &getLatencyStats() const { return stats; }
+
+private:
+  sf::Socket::Status receiveDatagrams(sf::Packet &packet, sf::Time timeout);
+
+  sf::Socket::Status receiveSharedFrame(sf::Packet &packet, sf::Time timeout);
+
+  bool readRelayedFrame(sf::Packet &packet);
+
+  sf::Socket::Status fail(sf::Socket::Status status);
 };
 
 } // namespace cycles
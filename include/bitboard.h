@@ -0,0 +1,90 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace cycles {
+
+/**
+ * @brief One bit per grid cell telling whether the cell is occupied
+ *
+ * Every row is padded with a set bit on each side and a fully set row is
+ * added above and below the grid, so the cells just outside the grid read
+ * as occupied. Checking a neighbor therefore never needs a bounds check, and
+ * the four neighbors of a cell are read with a handful of shifts and masks.
+ */
+class OccupancyBitboard {
+  int width = 0;
+  int height = 0;
+  int stride = 0; // 64-bit words per padded row
+  std::vector<std::uint64_t> words;
+
+  // Position of a cell in the padded board
+  std::size_t bitIndex(int x, int y) const {
+    return static_cast<std::size_t>(y + 1) * stride * 64 + (x + 1);
+  }
+
+public:
+  OccupancyBitboard() = default;
+
+  /**
+   * @brief Build the board from a grid of cell owners
+   *
+   * Reuses the memory of the previous board when the size does not change.
+   *
+   * @param grid The grid in row-major order, 0 for empty cells
+   * @param width The width of the grid (in cells)
+   * @param height The height of the grid (in cells)
+   */
+  void build(std::span<const std::uint8_t> grid, int width, int height);
+
+  /**
+   * @brief Check if a cell is occupied
+   *
+   * @param position A cell of the grid or a cell right next to it, cells
+   * outside the grid are occupied
+   */
+  bool isOccupied(sf::Vector2i position) const {
+    const auto bit = bitIndex(position.x, position.y);
+    return (words[bit / 64] >> (bit % 64)) & 1;
+  }
+
+  /**
+   * @brief Get the free neighbors of a cell
+   *
+   * @param position A cell of the grid
+   * @return A mask with bit d set if the neighbor in the direction of value
+   * d (see getDirectionValue) is free
+   */
+  std::uint8_t getFreeNeighbors(sf::Vector2i position) const {
+    const auto north = isOccupied({position.x, position.y - 1});
+    const auto east = isOccupied({position.x + 1, position.y});
+    const auto south = isOccupied({position.x, position.y + 1});
+    const auto west = isOccupied({position.x - 1, position.y});
+    return static_cast<std::uint8_t>(~(north | east << 1 | south << 2 |
+                                       west << 3) &
+                                     0xF);
+  }
+
+  /**
+   * @brief Get the words of a padded row, bit x + 1 holds cell x
+   *
+   * @param y A row of the grid, or -1 and height for the padding rows
+   */
+  std::span<const std::uint64_t> getRow(int y) const {
+    return {words.data() + static_cast<std::size_t>(y + 1) * stride,
+            static_cast<std::size_t>(stride)};
+  }
+
+  /**
+   * @brief Get the whole padded board, row after row
+   */
+  std::span<const std::uint64_t> getWords() const { return words; }
+
+  int getWidth() const { return width; }   ///< The width of the grid
+  int getHeight() const { return height; } ///< The height of the grid
+  int getStride() const { return stride; } ///< The words per padded row
+};
+
+} // namespace cycles
@@ -0,0 +1,168 @@
+#pragma once
+#include "api.h"
+#include "local_connection.h"
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <optional>
+
+namespace cycles {
+
+class BotLoop;
+
+/**
+ * @brief A coroutine running a bot on a BotLoop
+ *
+ * Any function returning BotTask may use `co_await` on the awaitables of a
+ * BotLoop. The coroutine starts suspended and runs when passed to
+ * BotLoop::run.
+ */
+class BotTask {
+public:
+  /// @cond INTERNAL
+  struct promise_type {
+    std::exception_ptr exception;
+    BotTask get_return_object() {
+      return BotTask(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+  /// @endcond
+
+  BotTask(BotTask &&other) noexcept : handle(other.handle) {
+    other.handle = nullptr;
+  }
+  BotTask &operator=(BotTask &&) = delete;
+  ~BotTask();
+
+private:
+  friend BotLoop;
+  explicit BotTask(std::coroutine_handle<promise_type> handle)
+      : handle(handle) {}
+  std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * @brief A small event loop driving a coroutine bot over a Connection or a
+ * LocalConnection
+ *
+ * With the blocking receiveGameState/sendMove pair a bot sits idle while it
+ * waits for the server. A coroutine bot instead awaits nextState(), thinks
+ * for as long as it likes while calling `co_await yield()` now and then, and
+ * sends its best move with `co_await move(direction)`. Every yield lets the
+ * loop poll the connection without blocking, so a state that arrives while
+ * the bot is thinking is picked up immediately and reported by
+ * isStateReady().
+ *
+ * A move decided on a state that has already been superseded by a newer one
+ * is not sent, since the server would apply it to the wrong frame.
+ */
+class BotLoop {
+  std::function<sf::Socket::Status(GameState &, sf::Time)> receive;
+  std::function<sf::Socket::Status(Direction)> send;
+  bool disconnected;
+  std::deque<std::coroutine_handle<>> ready;
+  std::coroutine_handle<> stateWaiter;
+  std::optional<GameState> pending;
+  int currentFrame = -1;
+  sf::Clock stateClock;
+
+  void poll(sf::Time timeout);
+  std::optional<GameState> takeState();
+
+public:
+  /// @cond INTERNAL
+  struct StateAwaiter {
+    BotLoop &loop;
+    bool await_ready() const {
+      return loop.pending.has_value() || loop.disconnected;
+    }
+    void await_suspend(std::coroutine_handle<> handle) {
+      loop.stateWaiter = handle;
+    }
+    std::optional<GameState> await_resume() { return loop.takeState(); }
+  };
+
+  struct MoveAwaiter {
+    BotLoop &loop;
+    Direction direction;
+    bool await_ready() const { return true; }
+    void await_suspend(std::coroutine_handle<>) {}
+    sf::Socket::Status await_resume();
+  };
+
+  struct YieldAwaiter {
+    BotLoop &loop;
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() {}
+  };
+  /// @endcond
+
+  /**
+   * @brief Construct a new BotLoop object
+   *
+   * @param connection An established connection to the server
+   */
+  explicit BotLoop(Connection &connection);
+
+  /**
+   * @brief Construct a BotLoop playing in a match of the same process
+   *
+   * @param connection A connection obtained from the match
+   */
+  explicit BotLoop(LocalConnection &connection);
+
+  /**
+   * @brief Run a bot until its coroutine returns
+   *
+   * Exceptions thrown by the coroutine are rethrown here.
+   *
+   * @param task The coroutine of the bot
+   */
+  void run(BotTask task);
+
+  /**
+   * @brief Wait for the next game state
+   *
+   * Resumes immediately if a state arrived while the bot was thinking.
+   *
+   * @return An awaitable resuming with the new game state, or with
+   * std::nullopt once the connection is lost
+   */
+  StateAwaiter nextState() { return {*this}; }
+
+  /**
+   * @brief Send a move for the last state returned by nextState
+   *
+   * @param direction The direction of the move
+   * @return An awaitable resuming with the status of the send: Done if the
+   * move was sent, NotReady if it was dropped because a newer state already
+   * arrived, Disconnected or Error if the connection was lost
+   */
+  MoveAwaiter move(Direction direction) { return {*this, direction}; }
+
+  /**
+   * @brief Let the loop poll the connection
+   *
+   * Bots that think for a long time should yield regularly so that new
+   * states are noticed as soon as they arrive.
+   */
+  YieldAwaiter yield() { return {*this}; }
+
+  /**
+   * @brief Check if a state newer than the one the bot is working on arrived
+   */
+  bool isStateReady() const { return pending.has_value(); }
+
+  /**
+   * @brief Get the time elapsed since the last state was received
+   */
+  sf::Time getTimeSinceState() const { return stateClock.getElapsedTime(); }
+};
+
+} // namespace cycles
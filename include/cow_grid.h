@@ -0,0 +1,144 @@
+#pragma once
+#include "api.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace cycles {
+
+/**
+ * @brief A grid of cell owners split in square chunks shared between copies
+ *
+ * The chunks of the grid a CowGrid was built from are immutable and shared
+ * by all its copies; a chunk is duplicated the first time a copy writes to
+ * it, and the duplicate is shared in turn by the copies made afterwards.
+ * A grid only keeps the chunks it has written, sorted by index, so copying
+ * a CowGrid copies and updates one reference count per written chunk: search
+ * branches cost time and memory in proportion to the chunks they touch, and
+ * threads branching from the same grid do not fight over reference counts. Copies can be used and written
+ * from different threads, as long as a single CowGrid object is not written
+ * from two threads at once.
+ */
+class CowGrid {
+public:
+  /// Log2 of the side of a chunk (in cells)
+  static constexpr int chunkBits = 5;
+  /// Side of a chunk (in cells)
+  static constexpr int chunkSize = 1 << chunkBits;
+
+  CowGrid() = default;
+
+  /**
+   * @brief Construct a new CowGrid object from a grid in row-major order
+   *
+   * @param grid The owner of every cell, 0 for empty cells
+   * @param width The width of the grid (in cells)
+   * @param height The height of the grid (in cells)
+   */
+  CowGrid(std::span<const Id> grid, int width, int height);
+
+  /**
+   * @brief Construct a new CowGrid object from the whole arena of a state
+   */
+  explicit CowGrid(const GameState &state);
+
+  /**
+   * @brief Get the owner of a cell (0 if empty)
+   */
+  Id get(sf::Vector2i position) const {
+    return chunk(chunkIndex(position))[cellIndex(position)];
+  }
+
+  /**
+   * @brief Set the owner of a cell, copying its chunk if it is shared
+   */
+  void set(sf::Vector2i position, Id value) {
+    const auto index = chunkIndex(position);
+    const auto slot = findWritten(index);
+    if (slot == writtenIndices.size() || writtenIndices[slot] != index) {
+      insertWritten(slot, index);
+    } else if (written[slot].use_count() != 1) {
+      written[slot] = std::make_shared<Chunk>(*written[slot]);
+    } else {
+      // Pairs with the release of the copies that dropped the chunk
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    (*written[slot])[cellIndex(position)] = value;
+  }
+
+  /**
+   * @brief Check if a position is inside the grid
+   */
+  bool isInside(sf::Vector2i position) const {
+    return position.x >= 0 && position.x < width && position.y >= 0 &&
+           position.y < height;
+  }
+
+  int getWidth() const { return width; }
+
+  int getHeight() const { return height; }
+
+  /**
+   * @brief Get the number of chunks
+   */
+  int getChunkCount() const {
+    return base == nullptr ? 0 : static_cast<int>(base->size());
+  }
+
+  /**
+   * @brief Get the number of chunks this grid shares with another one
+   */
+  int countSharedChunks(const CowGrid &other) const;
+
+  /**
+   * @brief Write the grid in row-major order
+   */
+  void copyTo(std::vector<Id> &grid) const;
+
+private:
+  using Chunk = std::array<Id, chunkSize * chunkSize>;
+
+  int width = 0;
+  int height = 0;
+  int chunksPerRow = 0;
+  // The chunks of the original grid, never written
+  std::shared_ptr<const std::vector<Chunk>> base;
+  // The indices of the chunks written by this grid or the grids it was
+  // copied from, in increasing order
+  std::vector<std::uint32_t> writtenIndices;
+  // The duplicates of those chunks, in the same order
+  std::vector<std::shared_ptr<Chunk>> written;
+
+  std::size_t chunkIndex(sf::Vector2i position) const {
+    return static_cast<std::size_t>(position.y >> chunkBits) * chunksPerRow +
+           (position.x >> chunkBits);
+  }
+
+  static std::size_t cellIndex(sf::Vector2i position) {
+    return ((position.y & (chunkSize - 1)) << chunkBits) |
+           (position.x & (chunkSize - 1));
+  }
+
+  // The position of a chunk in writtenIndices, or where it would be inserted
+  std::size_t findWritten(std::size_t index) const {
+    return static_cast<std::size_t>(
+        std::lower_bound(writtenIndices.begin(), writtenIndices.end(), index) -
+        writtenIndices.begin());
+  }
+
+  const Chunk &chunk(std::size_t index) const {
+    const auto slot = findWritten(index);
+    if (slot < writtenIndices.size() && writtenIndices[slot] == index) {
+      return *written[slot];
+    }
+    return (*base)[index];
+  }
+
+  void insertWritten(std::size_t slot, std::size_t index);
+};
+
+} // namespace cycles
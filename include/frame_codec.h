@@ -0,0 +1,86 @@
+#pragma once
+#include "api.h"
+#include "protocol.h"
+#include <SFML/Network.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace cycles {
+
+/**
+ * @brief Write the header a frame starts with, before its players
+ *
+ * @param packet Receives the header
+ * @param serverTime When the frame was sent, relative to the server's start
+ * @param moveBudget How long the players have to answer the frame
+ * @param arenaSize The size of the whole arena (in cells)
+ * @param playerCount The number of players written after the header
+ */
+void writeFrameHeader(sf::Packet &packet, sf::Time serverTime,
+                      sf::Time moveBudget, sf::Vector2i arenaSize,
+                      std::size_t playerCount);
+
+/**
+ * @brief Write one player of a frame, after the header
+ *
+ * The tail goes as 2-bit steps so that clients can simulate its end.
+ *
+ * @param packet Receives the player
+ * @param player The player, a Player or the server's own player type
+ * @param frameNumber The frame the player is written for
+ * @param packedTail Scratch buffer, reused between calls
+ */
+template <class PlayerType>
+void writePlayer(sf::Packet &packet, const PlayerType &player, int frameNumber,
+                 std::vector<sf::Uint8> &packedTail) {
+  packet << player.position.x << player.position.y << player.color.r
+         << player.color.g << player.color.b << player.name << player.id
+         << static_cast<sf::Int32>(frameNumber);
+  protocol::packTail(player.position, player.tail, packedTail);
+  packet << static_cast<sf::Uint32>(player.tail.size());
+  for (auto byte : packedTail) {
+    packet << byte;
+  }
+}
+
+/**
+ * @brief Write a game state in the format the server sends frames in
+ *
+ * @param packet Receives the frame
+ * @param state The state, with the tails of the players
+ */
+void writeFrame(sf::Packet &packet, const GameState &state);
+
+/**
+ * @brief Read a frame written by the server or by writeFrame
+ *
+ * @param packet The frame
+ * @param state Receives the game state
+ * @return false if the frame is malformed
+ */
+bool readFrame(sf::Packet &packet, GameState &state);
+
+/**
+ * @brief Write the changes between two game states holding the whole grid
+ *
+ * The players are written in full, the grid as the list of cells that
+ * changed, which is much smaller than the grid on all but the first frames.
+ *
+ * @param packet Receives the delta
+ * @param previous The state the delta applies to
+ * @param state The state to encode
+ */
+void writeDelta(sf::Packet &packet, const GameState &previous,
+                const GameState &state);
+
+/**
+ * @brief Apply a delta written by writeDelta
+ *
+ * @param packet The delta
+ * @param state The state the delta was computed from, receives the new
+ * state
+ * @return false if the delta is malformed or was computed from another frame
+ */
+bool readDelta(sf::Packet &packet, GameState &state);
+
+} // namespace cycles
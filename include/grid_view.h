@@ -0,0 +1,114 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace cycles {
+
+/// Value of the cells of the border around a padded grid
+constexpr std::uint8_t wallCell = 255;
+
+/**
+ * @brief A read-only view of a grid stored with a border of wall cells
+ *
+ * Rows are getStride() cells apart and the grid is surrounded by one cell
+ * of wallCell on every side, so any cell of the grid or next to it can be
+ * read without checking the bounds first: a move is legal exactly when the
+ * cell it leads to reads 0.
+ *
+ * Positions are given in the same coordinates as the grid it views, i.e.
+ * relative to the arena (see GameState::windowOffset).
+ */
+class GridView {
+  const std::uint8_t *origin = nullptr; // cell (0, 0) of the grid
+  int stride = 0;
+  int width = 0;
+  int height = 0;
+  sf::Vector2i offset;
+
+public:
+  GridView() = default;
+
+  /**
+   * @brief Construct a new GridView object
+   *
+   * @param padded The storage, (width + 2) x (height + 2) cells with the
+   * border, see padGrid
+   * @param width The width of the grid (in cells, without the border)
+   * @param height The height of the grid (in cells, without the border)
+   * @param offset The position of the first cell of the grid
+   */
+  GridView(const std::uint8_t *padded, int width, int height,
+           sf::Vector2i offset = {})
+      : origin(padded + width + 3), stride(width + 2), width(width),
+        height(height), offset(offset) {}
+
+  /**
+   * @brief Get the position of a cell in the storage, relative to the first
+   * cell of the grid
+   *
+   * @param position A cell of the grid or of its border
+   */
+  std::ptrdiff_t index(sf::Vector2i position) const {
+    return static_cast<std::ptrdiff_t>(position.y - offset.y) * stride +
+           position.x - offset.x;
+  }
+
+  /**
+   * @brief Get the value of a cell of the grid or of its border
+   */
+  std::uint8_t get(sf::Vector2i position) const {
+    return origin[index(position)];
+  }
+
+  /**
+   * @brief Check if a cell of the grid or of its border is free
+   */
+  bool isFree(sf::Vector2i position) const { return get(position) == 0; }
+
+  /**
+   * @brief Get the legal moves from a cell of the grid
+   *
+   * @return A mask with bit d set if the direction of value d (see
+   * getDirectionValue) leads to a free cell
+   */
+  std::uint8_t getFreeNeighbors(sf::Vector2i position) const {
+    const auto *cell = origin + index(position);
+    return static_cast<std::uint8_t>((cell[-stride] == 0) |
+                                     (cell[1] == 0) << 1 |
+                                     (cell[stride] == 0) << 2 |
+                                     (cell[-1] == 0) << 3);
+  }
+
+  /// The first cell of the grid; the next row starts getStride() cells later
+  const std::uint8_t *data() const { return origin; }
+
+  int getStride() const { return stride; }
+
+  int getWidth() const { return width; }
+
+  int getHeight() const { return height; }
+
+  sf::Vector2i getOffset() const { return offset; }
+};
+
+/**
+ * @brief Copy a row-major grid into storage with a border of wall cells
+ *
+ * @param padded Receives (width + 2) x (height + 2) cells; its memory is
+ * reused between calls
+ */
+inline void padGrid(std::span<const std::uint8_t> grid, int width, int height,
+                    std::vector<std::uint8_t> &padded) {
+  const auto stride = static_cast<std::size_t>(width) + 2;
+  padded.assign(stride * (height + 2), wallCell);
+  for (int y = 0; y < height; ++y) {
+    std::copy_n(grid.begin() + static_cast<std::size_t>(y) * width, width,
+                padded.begin() + (y + 1) * stride + 1);
+  }
+}
+
+} // namespace cycles
@@ -0,0 +1,126 @@
+#pragma once
+#include "api.h"
+#include "spsc_queue.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace cycles {
+
+/**
+ * @brief A move sent through a LocalChannel, tagged with the frame it answers
+ */
+struct LocalMove {
+  int frame = -1;                       ///< The frame the move was decided on
+  Direction direction = Direction::north; ///< The direction of the move
+};
+
+/**
+ * @brief The in-process link between a bot and a match running in the same
+ * process
+ *
+ * The match thread pushes one immutable snapshot per frame into `states` and
+ * the bot thread answers through `moves`. Both queues are single producer /
+ * single consumer, so no locks are taken on either side.
+ */
+struct LocalChannel {
+  SpscQueue<std::shared_ptr<const GameState>, 4> states; ///< match -> bot
+  SpscQueue<LocalMove, 4> moves;                         ///< bot -> match
+  std::atomic<bool> open{true}; ///< Cleared by whichever side hangs up first
+  std::string name;             ///< The name of the player
+  sf::Color color;              ///< The color assigned to the player
+  Id id = 0;                    ///< The identifier assigned to the player
+};
+
+/**
+ * @brief A connection to a match running in the same process.
+ *
+ * Offers the same receiveGameState/sendMove contract as cycles::Connection
+ * but exchanges data through a LocalChannel instead of a TCP socket, which
+ * makes it suitable for high-speed self-play. Instances are obtained from the
+ * match the bot is playing in.
+ */
+class LocalConnection {
+  std::shared_ptr<LocalChannel> channel;
+  int frameNumber = 0;
+  int lastFrameSent = -1;
+
+public:
+  /**
+   * @brief Construct a new LocalConnection object
+   *
+   * @param channel The channel shared with the match
+   */
+  explicit LocalConnection(std::shared_ptr<LocalChannel> channel);
+
+  LocalConnection(LocalConnection &&) = default;
+  LocalConnection &operator=(LocalConnection &&) = default;
+
+  /**
+   * @brief Closes the channel so the match stops waiting for this bot
+   */
+  ~LocalConnection();
+
+  /**
+   * @brief Get the color assigned to the player
+   */
+  sf::Color getColor() const { return channel->color; }
+
+  /**
+   * @brief Send the player's move to the match
+   *
+   * Can only be called once per frame, after receiving the game state.
+   * Will return without doing nothing if the user is trying to send a move
+   * twice in the same frame.
+   *
+   * @param direction The direction of the move
+   */
+  void sendMove(Direction direction);
+
+  /**
+   * @brief Send the player's move to the match, like Connection::sendMove
+   *
+   * @param direction The direction of the move
+   * @param timeout The maximum time to wait, sf::Time::Zero waits forever
+   * @return sf::Socket::Status Done if the move was sent, NotReady if the
+   * timeout expired, Disconnected if the channel was closed
+   */
+  sf::Socket::Status sendMove(Direction direction, sf::Time timeout);
+
+  /**
+   * @brief Receive the game state from the match
+   *
+   * Will block until the next frame is published. If the match closes the
+   * channel while waiting (e.g. because the player died) an empty game state
+   * is returned and isActive() becomes false.
+   *
+   * @return GameState The game state
+   */
+  GameState receiveGameState();
+
+  /**
+   * @brief Receive the game state from the match, like
+   * Connection::receiveGameState
+   *
+   * @param state Receives the game state
+   * @param timeout The maximum time to wait, sf::Time::Zero waits forever
+   * @return sf::Socket::Status Done if a state was received, NotReady if the
+   * timeout expired, Disconnected if the channel was closed
+   */
+  sf::Socket::Status receiveGameState(GameState &state, sf::Time timeout);
+
+  /**
+   * @brief Check if the connection is active
+   *
+   * @return true if the match is still accepting moves from this player
+   * @return false if the channel has been closed
+   */
+  bool isActive() const;
+
+  /**
+   * @brief Close the channel
+   */
+  void close();
+};
+
+} // namespace cycles
@@ -0,0 +1,274 @@
+#pragma once
+#include <SFML/Config.hpp>
+#include <SFML/System.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cycles::protocol {
+
+/**
+ * @brief Optional features a client advertises after its name when it
+ * connects
+ */
+enum Capability : sf::Uint8 {
+  sharedMemoryCapability = 1 << 0, ///< The client mapped the server's frame buffer
+  udpCapability = 1 << 1, ///< The client listens for frames on a UDP port, sent after the capabilities
+  spectatorCapability = 1 << 2, ///< The client only watches the match; the frame interval it asks for (Uint16) follows the UDP port
+  deltaCapability = 1 << 3, ///< The spectator accepts frames encoded as changes to the previous one, see FrameKind
+};
+
+/**
+ * @brief Tag in front of every frame sent to a spectator whose deltas were
+ * accepted (the relay accepts them, the game server does not)
+ */
+enum class FrameKind : sf::Uint8 {
+  keyframe = 0, ///< A complete frame, see cycles::readFrame
+  delta = 1,    ///< The changes to the previous frame, see cycles::readDelta
+};
+
+/**
+ * @brief The transport the server picked for a client, sent after the color
+ */
+enum class Transport : sf::Uint8 {
+  tcp = 0,          ///< Frames and moves go through the TCP socket
+  sharedMemory = 1, ///< Frames and moves go through the shared frame buffer
+  udp = 2,          ///< Frames and moves go through UDP datagrams
+};
+
+/**
+ * @brief Name of the shared memory segment a server listening on a port
+ * publishes its frames in
+ */
+inline std::string sharedMemoryName(unsigned short port) {
+  return "/cycles_" + std::to_string(port);
+}
+
+/// Bytes of frame data carried by each UDP datagram, small enough to avoid IP
+/// fragmentation on common links
+constexpr std::size_t udpFragmentPayload = 1200;
+
+/// Largest frame a UDP client assembles when the server did not send its
+/// frame capacity (a Uint32 after the UDP port of its reply)
+constexpr std::size_t maxUdpFrameSize = 16 << 20;
+
+/// Size of the header in front of every UDP frame fragment
+constexpr std::size_t udpFragmentHeaderSize = 8;
+
+/// Size of a UDP move datagram: a compact move and a sequence number
+constexpr std::size_t udpMoveSize = 3;
+
+/// Number of low bits of the frame number carried by a compact move
+constexpr int moveFrameBits = 14;
+
+/**
+ * @brief How the grid section at the end of a frame is encoded
+ *
+ * The section starts with the window of the arena it covers (Int32 x, y,
+ * width and height), then this tag and the cells of the window.
+ */
+enum class GridEncoding : sf::Uint8 {
+  raw = 0,   ///< One byte per cell, row-major
+  tiles = 1, ///< Run-length encoded tiles, see gridTileSize
+};
+
+/// Side of the tiles of GridEncoding::tiles (in cells). A window in tiles
+/// starts on a tile boundary; its tiles follow in row-major order, the cells
+/// of each tile in row-major order too, as (value, count) byte pairs with
+/// runs of 1 to 255 cells that may span several rows of the tile. Tiles at
+/// the right or bottom edge of the window are cut to the window.
+constexpr int gridTileSize = 32;
+
+/// Longest player name the server keeps (in bytes); longer names are cut
+constexpr std::size_t maxNameLength = 64;
+
+/**
+ * @brief Upper bound on the size of a frame carrying the whole grid
+ *
+ * Counts the frame header, every player with a name of maxNameLength bytes
+ * and the grid. Tails are bounded by the grid, since no two of them share a
+ * cell.
+ *
+ * @param cells The number of cells of the grid
+ * @param players The most players the frame may hold
+ */
+constexpr std::size_t maxFrameSize(std::size_t cells, std::size_t players) {
+  // Time, move budget, arena size and player count
+  constexpr std::size_t header = 8 + 4 + 8 + 4;
+  // Position, color, name, id, frame and tail length, plus the last byte of
+  // its packed tail, which may be partly filled
+  constexpr std::size_t player = 8 + 3 + 4 + maxNameLength + 1 + 4 + 4 + 1;
+  // Window and encoding of the grid
+  constexpr std::size_t grid = 16 + 1;
+  return header + players * player + grid + cells + cells / 4;
+}
+
+/**
+ * @brief Number of bytes of a tail packed with packTail
+ */
+constexpr std::size_t packedTailSize(std::size_t length) {
+  return (length + 3) / 4;
+}
+
+/**
+ * @brief The direction value (see getDirectionValue) of the step between two
+ * adjacent cells
+ */
+inline sf::Uint8 stepValue(sf::Vector2i from, sf::Vector2i to) {
+  return to.y < from.y ? 0 : to.x > from.x ? 1 : to.y > from.y ? 2 : 3;
+}
+
+/**
+ * @brief Pack a tail as the steps from every cell to the next older one,
+ * four 2-bit direction values per byte, lowest bits first
+ *
+ * @param head The position of the head
+ * @param tail The cells of the tail, newest first, each next to the previous
+ * one
+ * @param out Receives packedTailSize(tail.size()) bytes
+ */
+template <class Cells>
+void packTail(sf::Vector2i head, const Cells &tail,
+              std::vector<sf::Uint8> &out) {
+  out.assign(packedTailSize(tail.size()), 0);
+  auto previous = head;
+  std::size_t index = 0;
+  for (const auto &cell : tail) {
+    out[index / 4] |= stepValue(previous, cell) << (index % 4 * 2);
+    previous = cell;
+    ++index;
+  }
+}
+
+/**
+ * @brief Unpack a tail packed with packTail
+ *
+ * @param head The position of the head
+ * @param data The packed steps
+ * @param length The number of cells of the tail
+ * @param tail Receives the cells of the tail, newest first
+ */
+void unpackTail(sf::Vector2i head, const sf::Uint8 *data, std::size_t length,
+                std::vector<sf::Vector2i> &tail);
+
+/**
+ * @brief Header of a UDP datagram carrying a piece of a serialized frame
+ */
+struct FragmentHeader {
+  sf::Int32 frame;  ///< The frame the fragment belongs to
+  sf::Uint16 index; ///< The position of the fragment in the frame
+  sf::Uint16 count; ///< The number of fragments of the frame
+};
+
+/**
+ * @brief Pack a move into two bytes
+ *
+ * The direction takes the two low bits and the remaining bits hold the low
+ * bits of the frame number the move answers, which is enough for the server
+ * to tell a move for the current frame from a stale one.
+ *
+ * @param frame The frame the move answers
+ * @param direction The direction value of the move (0 to 3)
+ */
+constexpr sf::Uint16 encodeMove(int frame, int direction) {
+  return static_cast<sf::Uint16>(
+      ((frame & ((1 << moveFrameBits) - 1)) << 2) | (direction & 3));
+}
+
+/**
+ * @brief Unpack a move if it answers a given frame
+ *
+ * @param move The packed move
+ * @param frame The frame the server is currently collecting moves for
+ * @param direction Receives the direction value of the move
+ * @return false if the move was decided on another frame
+ */
+constexpr bool decodeMove(sf::Uint16 move, int frame, int &direction) {
+  if ((move >> 2) != (frame & ((1 << moveFrameBits) - 1))) {
+    return false;
+  }
+  direction = move & 3;
+  return true;
+}
+
+/**
+ * @brief A move sent over UDP
+ *
+ * Clients may send a move more than once to cope with packet loss; for a
+ * given frame the server keeps the one with the highest sequence number.
+ */
+struct UdpMove {
+  sf::Uint16 move;    ///< The packed move, see encodeMove
+  sf::Uint8 sequence; ///< Increases with every move sent by the client
+};
+
+/**
+ * @brief Write a fragment header in network byte order
+ */
+void writeFragmentHeader(const FragmentHeader &header, std::byte *out);
+
+/**
+ * @brief Read a fragment header from a datagram
+ *
+ * @return false if the datagram is too short or the header is inconsistent
+ */
+bool readFragmentHeader(const std::byte *data, std::size_t size,
+                        FragmentHeader &header);
+
+/**
+ * @brief Write a move datagram in network byte order
+ */
+void writeUdpMove(const UdpMove &move, std::byte *out);
+
+/**
+ * @brief Read a move datagram
+ *
+ * @return false if the datagram does not hold a valid move
+ */
+bool readUdpMove(const std::byte *data, std::size_t size, UdpMove &move);
+
+/**
+ * @brief Rebuilds serialized frames from UDP fragments
+ *
+ * Fragments of frames older than the one being assembled, or older than the
+ * last completed frame, are dropped, so a late frame never overrides a newer
+ * one. A frame with a lost fragment is abandoned as soon as a newer frame
+ * starts arriving. Frames announced with more fragments than the capacity
+ * the assembler was made for are dropped before any memory is reserved.
+ */
+class FrameAssembler {
+  std::size_t maxFragments;
+  int assembling = -1;
+  int missing = 0;
+  std::size_t assembledSize = 0;
+  std::vector<std::byte> buffer;
+  std::vector<bool> received;
+  int completedFrame = -1;
+  std::vector<std::byte> completed;
+
+public:
+  /**
+   * @param frameCapacity The largest frame the server sends (in bytes)
+   */
+  explicit FrameAssembler(std::size_t frameCapacity = maxUdpFrameSize);
+
+  /**
+   * @brief Add a datagram
+   *
+   * @return true if the datagram completed a frame newer than any completed
+   * before
+   */
+  bool add(const std::byte *data, std::size_t size);
+
+  /**
+   * @brief The number of the last completed frame (-1 if none)
+   */
+  int getCompletedFrame() const { return completedFrame; }
+
+  /**
+   * @brief The serialized data of the last completed frame
+   */
+  const std::vector<std::byte> &getCompleted() const { return completed; }
+};
+
+} // namespace cycles::protocol
@@ -0,0 +1,14 @@
+#pragma once
+
+namespace cycles::rules {
+
+/**
+ * @brief The number of tail cells behind a head before the oldest one is
+ * freed, in a given frame
+ *
+ * Shared by the server and the client-side simulator so that both apply the
+ * same tail growth.
+ */
+constexpr int maxTailLength(int frame) { return 55 + frame / 100; }
+
+} // namespace cycles::rules
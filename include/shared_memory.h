@@ -0,0 +1,117 @@
+#pragma once
+#include "utils.h"
+#include <SFML/Network.hpp>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace cycles {
+
+/**
+ * @brief A shared memory segment through which a server and the bots running
+ * on the same host exchange frames and moves without going through sockets.
+ *
+ * The server writes every frame once into a small ring of frame slots, each
+ * guarded by a sequence counter so that readers can detect (and retry) a copy
+ * that raced with a write. Every client owns a move slot holding a single
+ * word with the frame number and the direction of its latest move.
+ *
+ * Only available on POSIX systems; create() and open() return nullptr
+ * elsewhere.
+ */
+class SharedFrameBuffer {
+  struct Header;
+  struct MoveSlot;
+  struct FrameSlot;
+
+  std::string name;
+  void *memory = nullptr;
+  std::size_t size = 0;
+  bool owner = false;
+  Header *header = nullptr;
+  MoveSlot *moveSlots = nullptr;
+  std::byte *frameSlots = nullptr;
+
+  SharedFrameBuffer() = default;
+  bool map(int fd, std::size_t bytes);
+  FrameSlot &frameSlot(int index) const;
+
+public:
+  SharedFrameBuffer(const SharedFrameBuffer &) = delete;
+  SharedFrameBuffer &operator=(const SharedFrameBuffer &) = delete;
+
+  /**
+   * @brief Unmaps the segment, and removes it if this process created it
+   */
+  ~SharedFrameBuffer();
+
+  /**
+   * @brief Create the segment (server side)
+   *
+   * @param name The name of the segment, see protocol::sharedMemoryName
+   * @param frameCapacity The maximum size of a serialized frame (in bytes)
+   * @param clientSlots The number of move slots
+   * @return The mapped segment or nullptr if it could not be created
+   */
+  static std::unique_ptr<SharedFrameBuffer>
+  create(const std::string &name, std::size_t frameCapacity, int clientSlots);
+
+  /**
+   * @brief Open an existing segment (client side)
+   *
+   * @param name The name of the segment, see protocol::sharedMemoryName
+   * @return The mapped segment or nullptr if there is no usable segment
+   */
+  static std::unique_ptr<SharedFrameBuffer> open(const std::string &name);
+
+  /**
+   * @brief Publish a serialized frame (server side)
+   *
+   * @return false if the frame does not fit in a slot
+   */
+  bool publishFrame(int frame, const void *data, std::size_t bytes);
+
+  /**
+   * @brief Copy the latest frame if it is newer than a given one (client side)
+   *
+   * @param afterFrame Only frames with a higher number are copied
+   * @param packet Receives the serialized frame
+   * @param frame Receives the number of the copied frame
+   * @return true if a newer frame was copied
+   */
+  bool readFrame(int afterFrame, sf::Packet &packet, int &frame) const;
+
+  /**
+   * @brief Post the move of a client for a frame (client side)
+   */
+  void postMove(int slot, int frame, Direction direction);
+
+  /**
+   * @brief Take the move a client posted for a frame (server side)
+   *
+   * @return true if the client posted a move for exactly that frame
+   */
+  bool takeMove(int slot, int frame, Direction &direction);
+
+  /**
+   * @brief Mark a move slot as closed, e.g. because its player died
+   */
+  void closeSlot(int slot);
+
+  /**
+   * @brief Reopen a move slot for a new client
+   */
+  void openSlot(int slot);
+
+  /**
+   * @brief Check if the server closed a move slot
+   */
+  bool isSlotClosed(int slot) const;
+
+  /**
+   * @brief Get the number of move slots
+   */
+  int getClientSlots() const;
+};
+
+} // namespace cycles
@@ -0,0 +1,154 @@
+#pragma once
+#include "api.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace cycles {
+
+/**
+ * @brief A copy of the game that bots can play moves on and take them back,
+ * for lookahead searches
+ *
+ * Applies the same rules as the server: every player moves at the same
+ * time; a player dies if it moves out of the grid, into an occupied cell
+ * (checked before anyone moves) or into the same cell as another player;
+ * the cells of dead players are freed; and a tail longer than
+ * rules::maxTailLength frees its oldest cell as the player moves.
+ *
+ * The grid is surrounded by wall cells so moves need no bounds checks, and
+ * tails are ring buffers sized for the search horizon, so make and unmake
+ * run in O(players) time and never allocate.
+ */
+class Simulator {
+public:
+  /// Value of the wall cells around the grid
+  static constexpr std::uint8_t wall = wallCell;
+
+  /**
+   * @brief Construct a new Simulator object
+   *
+   * @param state The state to start from, with the tails of the players
+   * @param horizon The maximum number of moves made without unmaking them
+   */
+  explicit Simulator(const GameState &state, int horizon = 256);
+
+  /**
+   * @brief Move every player that is alive
+   *
+   * @param directions One direction per player, in the order of
+   * GameState::players; the directions of dead players are ignored
+   */
+  void make(std::span<const Direction> directions);
+
+  /**
+   * @brief Take back the last move made
+   */
+  void unmake();
+
+  /**
+   * @brief Get the number of the frame the next move is made in
+   */
+  int getFrame() const { return frame; }
+
+  /**
+   * @brief Get the number of moves made and not unmade yet
+   */
+  int getDepth() const { return depth; }
+
+  /**
+   * @brief Get the number of players
+   */
+  int getPlayerCount() const { return static_cast<int>(agents.size()); }
+
+  /**
+   * @brief Get the number of players alive
+   */
+  int getAliveCount() const { return aliveCount; }
+
+  /**
+   * @brief Check if the game is over, i.e. at most one player is alive
+   */
+  bool isGameOver() const { return aliveCount <= 1; }
+
+  /**
+   * @brief Check if a player is alive
+   *
+   * @param player The index of the player in GameState::players
+   */
+  bool isAlive(int player) const { return agents[player].alive; }
+
+  /**
+   * @brief Get the position of the head of a player
+   *
+   * @param player The index of the player in GameState::players
+   */
+  sf::Vector2i getPosition(int player) const {
+    return toPosition(agents[player].head);
+  }
+
+  /**
+   * @brief Get the legal moves of a player, see GameState::getLegalMoves
+   *
+   * @param player The index of the player in GameState::players
+   */
+  std::uint8_t getLegalMoves(int player) const;
+
+  /**
+   * @brief Get the value of a cell (0 if empty, else the owner's id)
+   *
+   * @param position A cell of the grid
+   */
+  Id getGridCell(sf::Vector2i position) const {
+    return grid[toCell(position)];
+  }
+
+private:
+  struct Agent {
+    int head = 0;
+    int tailStart = 0;  // ring buffer index of the newest tail cell
+    int tailLength = 0;
+    bool alive = true;
+    Id id = 0;
+  };
+
+  // What make changed for one player, enough to undo it
+  struct Change {
+    int target = 0;  // cell moved to, or -1 if the player did not move
+    int popped = -1; // tail cell freed, or -1
+    bool died = false;
+  };
+
+  int width;
+  int stride; // width + 2
+  int frame;
+  int depth = 0;
+  int horizon;
+  int aliveCount = 0;
+  int tailCapacity; // power of two
+  std::vector<std::uint8_t> grid;
+  std::vector<Agent> agents;
+  std::vector<int> tails;       // tailCapacity cells per player
+  std::vector<Change> history;  // one change per player and move made
+  std::vector<int> claims;      // per cell: index of a player moving there
+  std::vector<int> claimStamps; // per cell: move in which claims was set
+  int stamp = 0;
+  int offsets[4];
+
+  int toCell(sf::Vector2i position) const {
+    return (position.y + 1) * stride + position.x + 1;
+  }
+
+  sf::Vector2i toPosition(int cell) const {
+    return {cell % stride - 1, cell / stride - 1};
+  }
+
+  int &tailCell(int player, int index) {
+    return tails[player * tailCapacity +
+                 ((agents[player].tailStart + index) & (tailCapacity - 1))];
+  }
+
+  void paintBody(int player, std::uint8_t value);
+};
+
+} // namespace cycles
@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace cycles {
+
+/**
+ * @brief A bounded lock-free queue for exactly one producer and one consumer
+ *
+ * The producer only writes the tail index and the consumer only writes the
+ * head index, so both sides make progress without locks. Each index lives in
+ * its own cache line to avoid false sharing between the two threads.
+ *
+ * @tparam T The type of the stored elements
+ * @tparam Capacity The maximum number of queued elements (a power of two)
+ */
+template <typename T, std::size_t Capacity> class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "SpscQueue capacity must be a power of two");
+
+  std::array<T, Capacity> slots;
+  alignas(64) std::atomic<std::size_t> head{0}; ///< Next slot to read
+  alignas(64) std::atomic<std::size_t> tail{0}; ///< Next slot to write
+
+public:
+  /**
+   * @brief Push an element (producer side)
+   *
+   * @param value The element to push
+   * @return true if the element was queued
+   * @return false if the queue is full
+   */
+  bool push(T value) {
+    const auto t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    slots[t & (Capacity - 1)] = std::move(value);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Pop an element (consumer side)
+   *
+   * @param value Receives the popped element
+   * @return true if an element was popped
+   * @return false if the queue is empty
+   */
+  bool pop(T &value) {
+    const auto h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    auto &slot = slots[h & (Capacity - 1)];
+    value = std::move(slot);
+    slot = T();
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Check if the queue is empty
+   *
+   * The result is only a snapshot when called from a thread other than the
+   * consumer.
+   */
+  bool empty() const {
+    return head.load(std::memory_order_acquire) ==
+           tail.load(std::memory_order_acquire);
+  }
+};
+
+} // namespace cycles
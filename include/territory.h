@@ -0,0 +1,108 @@
+#pragma once
+#include "api.h"
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace cycles {
+
+namespace detail {
+// Rows of a padded board holding set bits, empty if first > last
+struct Rows {
+  int first;
+  int last;
+  bool empty() const { return first > last; }
+};
+} // namespace detail
+
+/**
+ * @brief Reachable area, distance maps and Voronoi territory for bots
+ *
+ * Works on the padded bit layout of OccupancyBitboard, treating the whole
+ * board as one long bit string: one BFS step for every cell at once is a
+ * shift by one bit (east and west) or by one padded row (north and south)
+ * followed by a mask of the free cells, so a step costs a few operations per
+ * 64 cells. The padding bits are never free, which keeps cells from leaking
+ * across rows.
+ *
+ * In viewport mode only the window of the state is evaluated: cells are
+ * still given in arena coordinates, cells outside the window count as
+ * occupied and heads outside the window are ignored.
+ *
+ * The evaluator keeps its buffers between calls, so evaluating every frame
+ * of a game does not allocate once the first frame is done.
+ */
+class TerritoryEvaluator {
+public:
+  /// Distance of the cells that cannot be reached
+  static constexpr std::uint16_t unreachable =
+      std::numeric_limits<std::uint16_t>::max();
+
+  /**
+   * @brief Prepare the evaluator for a game state
+   *
+   * @param state The state to evaluate, its occupancy bitboard must be up to
+   * date
+   */
+  void reset(const GameState &state);
+
+  /**
+   * @brief Count the free cells reachable from a cell
+   *
+   * @param start The cell to start from, usually a head; it is not counted
+   * @return int The number of reachable free cells
+   */
+  int floodFill(sf::Vector2i start);
+
+  /**
+   * @brief Compute the distance from the nearest of several cells to every
+   * cell
+   *
+   * @param sources The cells to start from, at distance 0
+   * @return The distances in row-major order over the window of the state,
+   * unreachable for occupied or enclosed cells
+   */
+  const std::vector<std::uint16_t> &
+  distances(std::span<const sf::Vector2i> sources);
+
+  /**
+   * @brief Count the free cells each player reaches strictly before every
+   * other player
+   *
+   * All heads grow at the same speed; cells reached by several players in
+   * the same step belong to nobody and stop the growth.
+   *
+   * @return One count per player, in the order of GameState::players
+   */
+  const std::vector<int> &voronoi();
+
+private:
+  const GameState *state = nullptr;
+  std::size_t stride = 0;
+  int height = 0;
+  std::vector<std::uint64_t> free;      // free cells
+  std::vector<std::uint64_t> mask;      // cells not reached yet in a search
+  std::vector<std::uint64_t> reached;   // the frontier of a search
+  std::vector<std::uint64_t> next;      // the next frontier of a search
+  std::vector<std::uint64_t> frontiers; // one frontier per player
+  std::vector<std::uint64_t> grown;     // one next frontier per player
+  std::vector<std::uint64_t> runs;      // scratch for filling a row
+  std::vector<detail::Rows> frontierRows;
+  std::vector<detail::Rows> scratchRows;
+  std::vector<std::uint64_t> seenOnce;
+  std::vector<std::uint64_t> seenTwice;
+  std::vector<std::uint16_t> distanceMap;
+  std::vector<int> territory;
+
+  std::size_t bitIndex(sf::Vector2i position) const;
+
+  detail::Rows seed(std::uint64_t *board, sf::Vector2i position);
+
+  // Breadth-first search from several cells, calling visit(step, word index,
+  // new cells) for every word of every layer
+  template <class Visit>
+  void search(std::span<const sf::Vector2i> sources, Visit &&visit);
+};
+
+} // namespace cycles
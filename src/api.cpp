@@ -1,104 +1,190 @@
 #include "api.h"
+#include "frame_codec.h"
+#include "protocol.h"
+#include "shared_memory.h"
 #include <SFML/Network.hpp>
+#include <algorithm>
 #include <spdlog/spdlog.h>
+#include <thread>
 
 namespace cycles {
 
 GameState::GameState(sf::Packet &packet) {
-  packet >> gridWidth >> gridHeight;
-  sf::Uint32 playerCount;
-  packet >> playerCount;
-  players.resize(playerCount);
-  for (sf::Uint32 i = 0; i < playerCount; ++i) {
-    int x, y;
-    sf::Uint8 r, g, b;
-    Id playerId;
-    std::string playerName;
-    packet >> x >> y >> r >> g >> b >> playerName >> playerId >> frameNumber;
-    players[i] = {playerName, sf::Color(r, g, b), sf::Vector2i(x, y), playerId};
-  }
-  grid.resize(gridWidth * gridHeight);
-  for (auto &cell : grid) {
-    packet >> cell;
-  }
-  //Check that the whole packet was read
-  if (!packet.endOfPacket()) {
-    spdlog::critical("There is still data left in the packet");
+  if (!readFrame(packet, *this)) {
+    spdlog::critical("Received a malformed game state");
     exit(1);
   }
 }
 
+void GameState::getArenaGrid(std::vector<Id> &arena) const {
+  const auto size = getArenaSize();
+  arena.assign(static_cast<std::size_t>(size.x) * size.y, 0);
+  for (int y = 0; y < gridHeight; ++y) {
+    std::copy_n(grid.begin() + static_cast<std::size_t>(y) * gridWidth,
+                gridWidth,
+                arena.begin() +
+                    static_cast<std::size_t>(y + windowOffset.y) * size.x +
+                    windowOffset.x);
+  }
+  for (const auto &player : players) {
+    arena[player.position.y * size.x + player.position.x] = player.id;
+    for (auto cell : player.tail) {
+      arena[cell.y * size.x + cell.x] = player.id;
+    }
+  }
+}
+
 namespace detail {
-std::shared_ptr<sf::TcpSocket> establishLink() {
-  spdlog::debug("Trying to connect");
-  auto socket = std::make_shared<sf::TcpSocket>();
+unsigned short getServerPort() {
   const char *port = std::getenv("CYCLES_PORT");
   if (port == nullptr) {
     spdlog::critical("Environment variable CYCLES_PORT not set");
     exit(1);
   }
-  const unsigned short SERVER_PORT = std::stoi(port);
-  spdlog::info("Connecting to server at {}:{}", SERVER_IP, SERVER_PORT);
-  if (socket->connect(SERVER_IP, SERVER_PORT) != sf::Socket::Done) {
-    spdlog::critical("Failed to connect to server");
-    exit(1);
+  return std::stoi(port);
+}
+
+// The host the server runs on, CYCLES_HOST if set. Resolved once, moves
+// are sent to it every frame.
+sf::IpAddress getServerAddress() {
+  static const sf::IpAddress address = [] {
+    const char *host = std::getenv("CYCLES_HOST");
+    return host == nullptr ? sf::IpAddress(SERVER_IP) : sf::IpAddress(host);
+  }();
+  return address;
+}
+
+// How long the handshake may take before the connection is given up
+const sf::Time handshakeTimeout = sf::seconds(5);
+
+// Computes the time left before a timeout expires, sf::Time::Zero meaning no
+// timeout. Returns false once the timeout expired.
+bool timeLeft(const sf::Clock &clock, sf::Time timeout, sf::Time &left) {
+  if (timeout == sf::Time::Zero) {
+    left = sf::Time::Zero;
+    return true;
+  }
+  left = timeout - clock.getElapsedTime();
+  return left > sf::Time::Zero;
+}
+
+std::shared_ptr<sf::TcpSocket> establishLink() {
+  spdlog::debug("Trying to connect");
+  auto socket = std::make_shared<sf::TcpSocket>();
+  const unsigned short SERVER_PORT = getServerPort();
+  const auto address = getServerAddress();
+  spdlog::info("Connecting to server at {}:{}", address.toString(),
+               SERVER_PORT);
+  if (socket->connect(address, SERVER_PORT, handshakeTimeout) !=
+      sf::Socket::Done) {
+    spdlog::error("Failed to connect to server");
+    return nullptr;
   }
+  // The socket stays non-blocking from now on, waits go through selectors
+  socket->setBlocking(false);
   return socket;
 }
 
-void sendPacket(std::shared_ptr<sf::TcpSocket> socket, sf::Packet &packet,
-                bool blocking = true) {
+sf::Socket::Status sendPacket(sf::TcpSocket &socket, sf::Packet &packet,
+                              sf::Time timeout) {
+  sf::Clock clock;
+  sf::Time left;
+  bool partial = false;
   int attempts = 0;
-  bool blockingState = socket->isBlocking();
-  socket->setBlocking(blocking);
-  auto status = sf::Socket::NotReady;
-  while (status != sf::Socket::Done && attempts < 10) {
-    status = socket->send(packet);
-    if (status == sf::Socket::NotReady) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  while (true) {
+    auto status = socket.send(packet);
+    if (status != sf::Socket::NotReady && status != sf::Socket::Partial) {
+      return status;
+    }
+    partial = partial || status == sf::Socket::Partial;
+    // The send buffer only fills up when the server stops reading
+    if (!timeLeft(clock, timeout, left)) {
+      // Giving up halfway through a packet would corrupt the stream
+      return partial ? sf::Socket::Error : sf::Socket::NotReady;
+    }
+    // SFML cannot wait for a socket to become writable, so retry a few times
+    // and then sleep instead of spinning until the deadline
+    if (attempts++ < 16) {
+      std::this_thread::yield();
+    } else {
+      auto pause = sf::milliseconds(1);
+      if (left != sf::Time::Zero && left < pause) {
+        pause = left;
+      }
+      sf::sleep(pause);
     }
-    attempts++;
-  }
-  if (status != sf::Socket::Done) {
-    spdlog::critical("Failed to send packet to server");
-    spdlog::critical("Reason: {}", socketErrorToString(status));
-    exit(1);
   }
-  socket->setBlocking(blockingState);
 }
 
-sf::Packet receivePacket(std::shared_ptr<sf::TcpSocket> socket,
-                         bool blocking = true) {
-  sf::Packet packet;
-  bool blockingState = socket->isBlocking();
-  socket->setBlocking(blocking);
-  sf::Socket::Status status = sf::Socket::NotReady;
-  int attempts = 0;
-  while (status != sf::Socket::Done && attempts < 10) {
-    status = socket->receive(packet);
-    if (status == sf::Socket::NotReady) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+sf::Socket::Status receivePacket(sf::TcpSocket &socket, sf::Packet &packet,
+                                 sf::Time timeout) {
+  sf::Clock clock;
+  sf::SocketSelector selector;
+  selector.add(socket);
+  sf::Time left;
+  while (true) {
+    // A partially received packet is kept by the socket until the next call
+    auto status = socket.receive(packet);
+    if (status != sf::Socket::NotReady && status != sf::Socket::Partial) {
+      return status;
     }
-    attempts++;
-  }
-  if (status != sf::Socket::Done) {
-    spdlog::critical("Failed to receive packet from server");
-    spdlog::critical("Reason: {}", socketErrorToString(status));
-    exit(1);
+    if (!timeLeft(clock, timeout, left)) {
+      return sf::Socket::NotReady;
+    }
+    selector.wait(left);
   }
-  socket->setBlocking(blockingState);
-  return packet;
 }
 
-std::shared_ptr<sf::TcpSocket> connectToServer(std::string playerName) {
+std::shared_ptr<sf::TcpSocket> connectToServer(std::string playerName,
+                                               sf::Uint8 capabilities,
+                                               unsigned short udpPort,
+                                               int frameInterval = 0) {
   auto socket = detail::establishLink();
-  // Send name to server
+  if (socket == nullptr) {
+    return nullptr;
+  }
+  // Send name and supported transports to server
   sf::Packet namePacket;
-  namePacket << playerName;
-  detail::sendPacket(socket, namePacket);
+  namePacket << playerName << capabilities;
+  if (capabilities & protocol::udpCapability) {
+    namePacket << static_cast<sf::Uint16>(udpPort);
+  }
+  if (capabilities & protocol::spectatorCapability) {
+    namePacket << static_cast<sf::Uint16>(frameInterval);
+  }
+  auto status = detail::sendPacket(*socket, namePacket, handshakeTimeout);
+  if (status != sf::Socket::Done) {
+    spdlog::error("Failed to send name to server: {}",
+                  socketErrorToString(status));
+    socket->disconnect();
+  }
   return socket;
 }
 
+// The transport requested through CYCLES_TRANSPORT (tcp, udp or shm), if any
+std::string getPreferredTransport() {
+  const char *transport = std::getenv("CYCLES_TRANSPORT");
+  return transport == nullptr ? "auto" : transport;
+}
+
+// Checks whether the server closed the TCP link. Only used while frames
+// arrive through another transport, when the server sends nothing over TCP.
+bool isServerGone(sf::TcpSocket &socket) {
+  char byte;
+  std::size_t received = 0;
+  auto status = socket.receive(&byte, 1, received);
+  return status == sf::Socket::Disconnected || status == sf::Socket::Error;
+}
+
+// Spin briefly, then yield, then sleep while waiting on shared memory
+void backoff(int attempt) {
+  if (attempt < 1000) {
+    std::this_thread::yield();
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+}
+
 }; // namespace detail
 
 sf::Color Connection::connect(std::string playerName) {
@@ -106,43 +192,286 @@ sf::Color Connection::connect(std::string playerName) {
   if (socket != nullptr) {
     spdlog::critical("Connection already established");
   }
-  socket = detail::connectToServer(playerName);
+  const auto preferredTransport = detail::getPreferredTransport();
+  sf::Uint8 capabilities = 0;
+  // Only advertise shared memory if the server's segment can be mapped
+  std::shared_ptr<SharedFrameBuffer> frameBuffer;
+  if (preferredTransport == "auto" || preferredTransport == "shm") {
+    frameBuffer = SharedFrameBuffer::open(
+        protocol::sharedMemoryName(detail::getServerPort()));
+  }
+  if (frameBuffer != nullptr) {
+    capabilities |= protocol::sharedMemoryCapability;
+  }
+  auto frameSocket = std::make_shared<sf::UdpSocket>();
+  if (preferredTransport == "udp" &&
+      frameSocket->bind(sf::Socket::AnyPort) == sf::Socket::Done) {
+    capabilities |= protocol::udpCapability;
+  }
+  socket = detail::connectToServer(playerName, capabilities,
+                                   frameSocket->getLocalPort());
+  if (socket == nullptr || !isActive()) {
+    return sf::Color::Black;
+  }
   sf::Color color;
-  sf::Packet colorPacket = detail::receivePacket(socket);
+  sf::Packet colorPacket;
+  auto status =
+      detail::receivePacket(*socket, colorPacket, detail::handshakeTimeout);
   sf::Uint8 r, g, b;
-  if (!(colorPacket >> r >> g >> b)) {
-    spdlog::critical("Failed to receive color from server");
-    exit(1);
+  if (status != sf::Socket::Done || !(colorPacket >> r >> g >> b)) {
+    spdlog::error("Failed to receive color from server");
+    socket->disconnect();
+    return sf::Color::Black;
   }
   color = sf::Color(r, g, b);
   spdlog::info("{}: Assigned color: R={} G={} B={}", playerName,
                static_cast<int>(r), static_cast<int>(g), static_cast<int>(b));
+  // Servers that do not know about transports stop after the color
+  sf::Uint8 transport;
+  sf::Uint32 slot;
+  sf::Uint16 udpPort;
+  if (!(colorPacket >> transport >> slot)) {
+    return color;
+  }
+  if (transport == static_cast<sf::Uint8>(protocol::Transport::sharedMemory) &&
+      frameBuffer != nullptr && static_cast<int>(slot) < frameBuffer->getClientSlots()) {
+    sharedMemory = frameBuffer;
+    moveSlot = slot;
+    spdlog::info("{}: Using shared memory transport", playerName);
+  }
+  if (transport == static_cast<sf::Uint8>(protocol::Transport::udp) &&
+      (capabilities & protocol::udpCapability) && colorPacket >> udpPort) {
+    frameSocket->setBlocking(false);
+    udpSocket = frameSocket;
+    serverUdpPort = udpPort;
+    // Older servers do not send their frame capacity
+    sf::Uint32 frameCapacity = 0;
+    if (!(colorPacket >> frameCapacity) || frameCapacity == 0) {
+      frameCapacity = protocol::maxUdpFrameSize;
+    }
+    assembler = std::make_shared<protocol::FrameAssembler>(frameCapacity);
+    datagram.resize(sf::UdpSocket::MaxDatagramSize);
+    spdlog::info("{}: Using UDP transport", playerName);
+  }
   return color;
 }
 
-void Connection::sendMove(Direction direction) {
+bool Connection::spectate(std::string name, int frameInterval) {
+  playerName = name;
+  if (socket != nullptr) {
+    spdlog::critical("Connection already established");
+  }
+  // Spectators always read frames from the TCP socket. Deltas only make
+  // sense when every frame is received.
+  const sf::Uint8 capabilities =
+      protocol::spectatorCapability |
+      (frameInterval <= 1 ? protocol::deltaCapability : 0);
+  socket = detail::connectToServer(name, capabilities, 0,
+                                   std::max(frameInterval, 1));
+  if (socket == nullptr || !isActive()) {
+    return false;
+  }
+  sf::Packet reply;
+  auto status = detail::receivePacket(*socket, reply, detail::handshakeTimeout);
+  sf::Uint8 r, g, b, transport;
+  sf::Uint32 slot;
+  sf::Uint16 interval;
+  if (status != sf::Socket::Done ||
+      !(reply >> r >> g >> b >> transport >> slot >> interval)) {
+    spdlog::error("{}: The server refused the spectator", name);
+    socket->disconnect();
+    return false;
+  }
+  // Servers that do not send deltas stop after the interval
+  sf::Uint8 acceptsDeltas = 0;
+  reply >> acceptsDeltas;
+  spectator = true;
+  spectatorInterval = interval;
+  if (acceptsDeltas != 0) {
+    deltaBase = std::make_shared<GameState>();
+  }
+  spdlog::info("{}: Watching every {} frames", name, interval);
+  return true;
+}
+
+sf::Socket::Status Connection::sendMove(Direction direction,
+                                        sf::Time timeout) {
+  if (spectator) {
+    spdlog::error("Spectators cannot send moves");
+    return sf::Socket::Error;
+  }
   if (frameNumber == lastFrameSent) {
     spdlog::warn("Trying to send move twice in the same frame, call "
                  "receiveGameState first");
-    return;
+    return sf::Socket::Done;
   }
   spdlog::debug("Sending move");
-  sf::Packet packet;
-  packet << getDirectionValue(direction);
-  detail::sendPacket(socket, packet);
-  lastFrameSent = frameNumber;
+  sf::Clock clock;
+  auto status = sf::Socket::Done;
+  if (sharedMemory != nullptr) {
+    sharedMemory->postMove(moveSlot, frameNumber, direction);
+  } else if (udpSocket != nullptr) {
+    // Sent twice so that a single lost datagram does not cost the move
+    std::byte datagram[protocol::udpMoveSize];
+    protocol::writeUdpMove(
+        {protocol::encodeMove(frameNumber, getDirectionValue(direction)),
+         ++moveSequence},
+        datagram);
+    bool sent = false;
+    for (int copy = 0; copy < 2; ++copy) {
+      sent = udpSocket->send(datagram, sizeof(datagram),
+                             detail::getServerAddress(),
+                             serverUdpPort) == sf::Socket::Done ||
+             sent;
+    }
+    status = sent ? sf::Socket::Done : sf::Socket::NotReady;
+  } else {
+    sf::Packet packet;
+    packet << protocol::encodeMove(frameNumber, getDirectionValue(direction));
+    status = detail::sendPacket(*socket, packet, timeout);
+  }
+  const auto elapsed = clock.getElapsedTime();
+  stats.lastSend = elapsed;
+  stats.maxSend = std::max(stats.maxSend, elapsed);
+  stats.totalSend += elapsed;
+  if (status == sf::Socket::Done) {
+    lastFrameSent = frameNumber;
+    ++stats.sends;
+  } else if (status != sf::Socket::NotReady) {
+    return fail(status);
+  }
+  return status;
 }
 
-GameState Connection::receiveGameState() {
+sf::Socket::Status Connection::receiveGameState(GameState &state,
+                                                sf::Time timeout) {
   spdlog::debug("Receiving game state");
-  auto packet = detail::receivePacket(socket);
-  GameState state(packet);
+  sf::Clock clock;
+  sf::Packet packet;
+  sf::Socket::Status status;
+  if (sharedMemory != nullptr) {
+    status = receiveSharedFrame(packet, timeout);
+  } else if (udpSocket != nullptr) {
+    status = receiveDatagrams(packet, timeout);
+  } else {
+    status = detail::receivePacket(*socket, packet, timeout);
+  }
+  const auto elapsed = clock.getElapsedTime();
+  stats.lastReceive = elapsed;
+  stats.maxReceive = std::max(stats.maxReceive, elapsed);
+  stats.totalReceive += elapsed;
+  if (status == sf::Socket::NotReady) {
+    return status;
+  }
+  if (status != sf::Socket::Done) {
+    return fail(status);
+  }
+  if (deltaBase != nullptr) {
+    if (!readRelayedFrame(packet)) {
+      spdlog::error("{}: Received a malformed frame", playerName);
+      return fail(sf::Socket::Error);
+    }
+    state = *deltaBase;
+  } else if (!readFrame(packet, state)) {
+    spdlog::error("{}: Received a malformed frame", playerName);
+    return fail(sf::Socket::Error);
+  }
+  // The fastest frame so far gives the offset between the two clocks, any
+  // frame arriving later than that was delayed on the way
+  const auto offset = clientClock.getElapsedTime() - state.serverTime;
+  if (stats.receives == 0 || offset < minClockOffset) {
+    minClockOffset = offset;
+  }
+  state.transitDelay = offset - minClockOffset;
   frameNumber = state.frameNumber;
+  lastFrameReceived = state.frameNumber;
+  ++stats.receives;
+  return status;
+}
+
+GameState Connection::receiveGameState() {
+  GameState state{};
+  receiveGameState(state);
   return state;
 }
 
+bool Connection::readRelayedFrame(sf::Packet &packet) {
+  sf::Uint8 kind = 0;
+  if (!(packet >> kind)) {
+    return false;
+  }
+  if (kind == static_cast<sf::Uint8>(protocol::FrameKind::keyframe)) {
+    return readFrame(packet, *deltaBase);
+  }
+  return kind == static_cast<sf::Uint8>(protocol::FrameKind::delta) &&
+         readDelta(packet, *deltaBase);
+}
+
+sf::Socket::Status Connection::receiveSharedFrame(sf::Packet &packet,
+                                                  sf::Time timeout) {
+  sf::Clock clock;
+  sf::Time left;
+  int frame;
+  int attempts = 0;
+  while (!sharedMemory->readFrame(lastFrameReceived, packet, frame)) {
+    // The server closes our slot when the player is removed
+    if (sharedMemory->isSlotClosed(moveSlot) ||
+        (attempts % 1000 == 999 && detail::isServerGone(*socket))) {
+      return sf::Socket::Disconnected;
+    }
+    if (!detail::timeLeft(clock, timeout, left)) {
+      return sf::Socket::NotReady;
+    }
+    detail::backoff(attempts++);
+  }
+  return sf::Socket::Done;
+}
+
+sf::Socket::Status Connection::receiveDatagrams(sf::Packet &packet,
+                                                sf::Time timeout) {
+  sf::Clock clock;
+  sf::Time left;
+  // The server sends nothing over TCP in this mode, so a readable TCP socket
+  // means the server closed the connection
+  sf::SocketSelector selector;
+  selector.add(*udpSocket);
+  selector.add(*socket);
+  while (true) {
+    // Drain everything queued so that only the newest complete frame is used
+    std::size_t received;
+    sf::IpAddress sender;
+    unsigned short senderPort;
+    while (udpSocket->receive(datagram.data(), datagram.size(), received,
+                              sender, senderPort) == sf::Socket::Done) {
+      if (senderPort == serverUdpPort) {
+        assembler->add(datagram.data(), received);
+      }
+    }
+    if (assembler->getCompletedFrame() > lastFrameReceived) {
+      const auto &frame = assembler->getCompleted();
+      packet.clear();
+      packet.append(frame.data(), frame.size());
+      return sf::Socket::Done;
+    }
+    if (!detail::timeLeft(clock, timeout, left)) {
+      return sf::Socket::NotReady;
+    }
+    if (selector.wait(left) && selector.isReady(*socket) &&
+        detail::isServerGone(*socket)) {
+      return sf::Socket::Disconnected;
+    }
+  }
+}
+
+sf::Socket::Status Connection::fail(sf::Socket::Status status) {
+  spdlog::error("{}: Lost connection to server: {}", playerName,
+                socketErrorToString(status));
+  socket->disconnect();
+  return status;
+}
+
 bool Connection::isActive() {
-  return socket->getRemoteAddress() != sf::IpAddress::None;
+  return socket != nullptr && socket->getRemoteAddress() != sf::IpAddress::None;
 }
 
 
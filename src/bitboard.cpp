@@ -0,0 +1,28 @@
+#include "bitboard.h"
+#include <algorithm>
+
+namespace cycles {
+
+void OccupancyBitboard::build(std::span<const std::uint8_t> grid, int width,
+                              int height) {
+  this->width = width;
+  this->height = height;
+  stride = (width + 2 + 63) / 64;
+  words.assign(static_cast<std::size_t>(height + 2) * stride, 0);
+  // Padding rows above and below the grid
+  std::fill_n(words.begin(), stride, ~std::uint64_t(0));
+  std::fill_n(words.end() - stride, stride, ~std::uint64_t(0));
+  for (int y = 0; y < height; ++y) {
+    auto *row = words.data() + static_cast<std::size_t>(y + 1) * stride;
+    const auto *cells = grid.data() + static_cast<std::size_t>(y) * width;
+    // Padding bits on both sides of the row
+    row[0] |= 1;
+    row[(width + 1) / 64] |= std::uint64_t(1) << ((width + 1) % 64);
+    for (int x = 0; x < width; ++x) {
+      row[(x + 1) / 64] |= static_cast<std::uint64_t>(cells[x] != 0)
+                           << ((x + 1) % 64);
+    }
+  }
+}
+
+} // namespace cycles
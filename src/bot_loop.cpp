@@ -0,0 +1,96 @@
+#include "bot_loop.h"
+#include <spdlog/spdlog.h>
+#include <utility>
+
+namespace cycles {
+
+BotTask::~BotTask() {
+  if (handle) {
+    handle.destroy();
+  }
+}
+
+BotLoop::BotLoop(Connection &connection)
+    : receive([&connection](GameState &state, sf::Time timeout) {
+        return connection.receiveGameState(state, timeout);
+      }),
+      send([&connection](Direction direction) {
+        return connection.sendMove(direction);
+      }),
+      disconnected(!connection.isActive()) {}
+
+BotLoop::BotLoop(LocalConnection &connection)
+    : receive([&connection](GameState &state, sf::Time timeout) {
+        return connection.receiveGameState(state, timeout);
+      }),
+      send([&connection](Direction direction) {
+        return connection.sendMove(direction, sf::Time::Zero);
+      }),
+      disconnected(!connection.isActive()) {}
+
+void BotLoop::poll(sf::Time timeout) {
+  GameState state;
+  const auto status = receive(state, timeout);
+  if (status == sf::Socket::Done) {
+    // An older state nobody looked at yet is simply replaced
+    pending = std::move(state);
+    stateClock.restart();
+  } else if (status != sf::Socket::NotReady) {
+    disconnected = true;
+  }
+}
+
+std::optional<GameState> BotLoop::takeState() {
+  auto state = std::move(pending);
+  pending.reset();
+  if (state) {
+    currentFrame = state->frameNumber;
+  }
+  return state;
+}
+
+sf::Socket::Status BotLoop::MoveAwaiter::await_resume() {
+  if (loop.disconnected) {
+    return sf::Socket::Disconnected;
+  }
+  if (loop.pending && loop.pending->frameNumber > loop.currentFrame) {
+    spdlog::debug("Dropping move for frame {}, frame {} already arrived",
+                  loop.currentFrame, loop.pending->frameNumber);
+    return sf::Socket::NotReady;
+  }
+  return loop.send(direction);
+}
+
+void BotLoop::YieldAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  if (!loop.pending && !loop.disconnected) {
+    // The shortest timeout the connection accepts, i.e. a poll
+    loop.poll(sf::microseconds(1));
+  }
+  loop.ready.push_back(handle);
+}
+
+void BotLoop::run(BotTask task) {
+  ready.push_back(task.handle);
+  while (!task.handle.done()) {
+    if (!ready.empty()) {
+      auto handle = ready.front();
+      ready.pop_front();
+      handle.resume();
+      continue;
+    }
+    if (stateWaiter) {
+      // Nothing else to run, so block until the server sends a frame
+      if (!pending && !disconnected) {
+        poll(sf::Time::Zero);
+      }
+      std::exchange(stateWaiter, nullptr).resume();
+      continue;
+    }
+    break;
+  }
+  if (task.handle.promise().exception) {
+    std::rethrow_exception(task.handle.promise().exception);
+  }
+}
+
+} // namespace cycles
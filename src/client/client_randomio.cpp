@@ -1,5 +1,6 @@
 #include "api.h"
 #include "utils.h"
+#include <algorithm>
 #include <iostream>
 #include <random>
 #include <spdlog/spdlog.h>
@@ -85,28 +86,10 @@ class BotClient {
     state.updatePlayerPositions(newPositions);
   }
 
-  bool is_valid_move(Direction direction) {
-    auto new_pos = my_player.position + getDirectionVector(direction);
-
-    // Check if the new position is inside the grid
-    if (!state.isInsideGrid(new_pos)) {
-      return false;
-    }
-
-    // Check if the new position collides with any player position
-    auto playerPositions = state.getPlayerPositions();
-    for (const auto& pos : playerPositions) {
-      if (new_pos == pos) {
-        return false; // Collision detected
-      }
-    }
-
-    // Check if the new position is empty
-    if (!state.isCellEmpty(new_pos)) {
-      return false;
-    }
-
-    return true;
+  bool is_valid_move(Direction direction, std::uint8_t legalMoves) {
+    // The inertia proposal is -1 before the first move
+    const int value = getDirectionValue(direction);
+    return value >= 0 && value < 4 && ((legalMoves >> value) & 1);
   }
 
   Direction decideMove() {
@@ -120,8 +103,9 @@ class BotClient {
     auto dist = std::uniform_int_distribution<int>(
         0, 3 + static_cast<int>(inertia * inertialDamping));
     Direction direction;
+    const auto legalMoves = state.getLegalMoves(my_player);
     do {
-      if (attempts >= max_attempts) {
+      if (legalMoves == 0 || attempts >= max_attempts) {
         spdlog::error("{}: Failed to find a valid move after {} attempts", name,
                       max_attempts);
         exit(1);
@@ -135,7 +119,7 @@ class BotClient {
       }
       direction = getDirectionFromValue(proposal);
       attempts++;
-    } while (!is_valid_move(direction));
+    } while (!is_valid_move(direction, legalMoves));
     spdlog::debug("{}: Valid move found after {} attempts, moving from ({}, "
                   "{}) to ({}, {}) in frame {}",
                   name, position.x, position.y, attempts,
@@ -144,14 +128,17 @@ class BotClient {
     return direction;
   }
 
-  void receiveGameState() {
-    state = connection.receiveGameState();
+  bool receiveGameState() {
+    if (connection.receiveGameState(state) != sf::Socket::Done) {
+      return false;
+    }
     for (const auto &player : state.players) {
       if (player.name == name) {
         my_player = player;
         break;
       }
     }
+    return true;
   }
 
   void sendMove() {
@@ -176,9 +163,18 @@ public:
 
   void run() {
     while (connection.isActive()) {
-      receiveGameState();
+      if (!receiveGameState()) {
+        break;
+      }
       sendMove();
     }
+    const auto &stats = connection.getLatencyStats();
+    if (stats.receives > 0) {
+      spdlog::info("{}: Waited {} us per state on average, sent moves in {} us "
+                   "on average",
+                   name, stats.totalReceive.asMicroseconds() / stats.receives,
+                   stats.totalSend.asMicroseconds() / std::max(stats.sends, 1));
+    }
   }
 };
 
@@ -0,0 +1,27 @@
+// Watches a match and logs the players still alive, as a starting point for
+// dashboards and analysis tools
+#include "api.h"
+#include <spdlog/spdlog.h>
+#include <string>
+
+using namespace cycles;
+
+int main(int argc, char *argv[]) {
+  const int frameInterval = argc > 1 ? std::stoi(argv[1]) : 10;
+  Connection connection;
+  if (!connection.spectate("spectator", frameInterval)) {
+    spdlog::critical("Failed to connect to the server as a spectator");
+    return 1;
+  }
+  GameState state;
+  while (connection.receiveGameState(state) == sf::Socket::Done) {
+    std::string names;
+    for (const auto &player : state.players) {
+      names += " " + player.name;
+    }
+    spdlog::info("Frame {}: {} players alive:{}", state.frameNumber,
+                 state.players.size(), names);
+  }
+  spdlog::info("The match is over");
+  return 0;
+}
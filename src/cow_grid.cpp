@@ -0,0 +1,66 @@
+#include "cow_grid.h"
+#include <algorithm>
+
+namespace cycles {
+
+CowGrid::CowGrid(std::span<const Id> grid, int width, int height)
+    : width(width), height(height),
+      chunksPerRow((width + chunkSize - 1) / chunkSize) {
+  const int chunkRows = (height + chunkSize - 1) / chunkSize;
+  const auto count = static_cast<std::size_t>(chunksPerRow) * chunkRows;
+  // Cells past the edge of the grid stay 0 and are never read
+  auto chunks = std::make_shared<std::vector<Chunk>>(count, Chunk{});
+  for (int y = 0; y < height; ++y) {
+    for (int x0 = 0; x0 < width; x0 += chunkSize) {
+      const auto cells = std::min(chunkSize, width - x0);
+      const auto *row = grid.data() + static_cast<std::size_t>(y) * width + x0;
+      std::copy(row, row + cells,
+                (*chunks)[chunkIndex({x0, y})].begin() + cellIndex({x0, y}));
+    }
+  }
+  base = std::move(chunks);
+}
+
+namespace detail {
+// Viewports are completed with the players to cover the whole arena
+std::vector<Id> arenaGrid(const GameState &state) {
+  std::vector<Id> arena;
+  state.getArenaGrid(arena);
+  return arena;
+}
+} // namespace detail
+
+CowGrid::CowGrid(const GameState &state)
+    : CowGrid(detail::arenaGrid(state), state.getArenaSize().x,
+              state.getArenaSize().y) {}
+
+void CowGrid::insertWritten(std::size_t slot, std::size_t index) {
+  // Base chunks are never written, the grid writes a duplicate instead
+  writtenIndices.insert(writtenIndices.begin() + slot,
+                        static_cast<std::uint32_t>(index));
+  written.insert(written.begin() + slot,
+                 std::make_shared<Chunk>((*base)[index]));
+}
+
+int CowGrid::countSharedChunks(const CowGrid &other) const {
+  const auto count = std::min(getChunkCount(), other.getChunkCount());
+  int shared = 0;
+  for (int index = 0; index < count; ++index) {
+    shared += &chunk(index) == &other.chunk(index);
+  }
+  return shared;
+}
+
+void CowGrid::copyTo(std::vector<Id> &grid) const {
+  grid.resize(static_cast<std::size_t>(width) * height);
+  for (int y = 0; y < height; ++y) {
+    for (int x0 = 0; x0 < width; x0 += chunkSize) {
+      const auto cells = std::min(chunkSize, width - x0);
+      const auto *row = chunk(chunkIndex({x0, y})).data() + cellIndex({x0, y});
+      std::copy(row, row + cells,
+                grid.begin() + static_cast<std::size_t>(y) * width + x0);
+    }
+  }
+}
+
+} // namespace cycles
@@ -0,0 +1,196 @@
+#include "frame_codec.h"
+#include "protocol.h"
+#include <algorithm>
+
+namespace cycles {
+
+void writeFrameHeader(sf::Packet &packet, sf::Time serverTime,
+                      sf::Time moveBudget, sf::Vector2i arenaSize,
+                      std::size_t playerCount) {
+  packet << static_cast<sf::Int64>(serverTime.asMicroseconds())
+         << static_cast<sf::Uint32>(moveBudget.asMicroseconds());
+  packet << arenaSize.x << arenaSize.y;
+  packet << static_cast<sf::Uint32>(playerCount);
+}
+
+namespace detail {
+// Everything but the grid, shared by frames and deltas
+void writePlayers(sf::Packet &packet, const GameState &state) {
+  writeFrameHeader(packet, state.serverTime, state.moveBudget,
+                   state.getArenaSize(), state.players.size());
+  std::vector<sf::Uint8> packedTail;
+  for (const auto &player : state.players) {
+    writePlayer(packet, player, state.frameNumber, packedTail);
+  }
+}
+
+bool readPlayers(sf::Packet &packet, GameState &state) {
+  std::vector<sf::Uint8> packedTail;
+  sf::Int64 timestamp = 0;
+  sf::Uint32 budget = 0;
+  packet >> timestamp >> budget;
+  state.serverTime = sf::microseconds(timestamp);
+  state.moveBudget = sf::microseconds(budget);
+  packet >> state.arenaSize.x >> state.arenaSize.y;
+  sf::Uint32 playerCount = 0;
+  packet >> playerCount;
+  if (!packet || state.arenaSize.x < 0 || state.arenaSize.y < 0) {
+    return false;
+  }
+  // Players and tails never share a cell, and each of them takes at least a
+  // byte of the packet, so larger counts can only come from a corrupt frame
+  const auto cells = static_cast<std::size_t>(state.arenaSize.x) *
+                     static_cast<std::size_t>(state.arenaSize.y);
+  if (playerCount > cells || playerCount > packet.getDataSize()) {
+    return false;
+  }
+  state.players.resize(playerCount);
+  for (auto &player : state.players) {
+    sf::Uint8 r = 0, g = 0, b = 0;
+    sf::Uint32 tailLength = 0;
+    packet >> player.position.x >> player.position.y >> r >> g >> b >>
+        player.name >> player.id >> state.frameNumber >> tailLength;
+    if (!packet || tailLength > cells ||
+        protocol::packedTailSize(tailLength) > packet.getDataSize()) {
+      return false;
+    }
+    player.color = sf::Color(r, g, b);
+    // Every byte holds four steps of the tail
+    packedTail.resize(protocol::packedTailSize(tailLength));
+    for (auto &byte : packedTail) {
+      packet >> byte;
+    }
+    if (!packet) {
+      return false;
+    }
+    protocol::unpackTail(player.position, packedTail.data(), tailLength,
+                         player.tail);
+  }
+  return true;
+}
+bool readTiles(sf::Packet &packet, GameState &state) {
+  const int width = state.gridWidth;
+  const int height = state.gridHeight;
+  for (int y0 = 0; y0 < height; y0 += protocol::gridTileSize) {
+    for (int x0 = 0; x0 < width; x0 += protocol::gridTileSize) {
+      const int tileWidth = std::min(protocol::gridTileSize, width - x0);
+      const int cells =
+          tileWidth * std::min(protocol::gridTileSize, height - y0);
+      int filled = 0;
+      while (filled < cells) {
+        sf::Uint8 value = 0, count = 0;
+        packet >> value >> count;
+        if (!packet || count == 0 || filled + count > cells) {
+          return false;
+        }
+        for (int cell = filled; cell < filled + count; ++cell) {
+          state.grid[(y0 + cell / tileWidth) * width + x0 +
+                     cell % tileWidth] = value;
+        }
+        filled += count;
+      }
+    }
+  }
+  return true;
+}
+} // namespace detail
+
+void writeFrame(sf::Packet &packet, const GameState &state) {
+  detail::writePlayers(packet, state);
+  packet << static_cast<sf::Int32>(state.windowOffset.x)
+         << static_cast<sf::Int32>(state.windowOffset.y)
+         << static_cast<sf::Int32>(state.gridWidth)
+         << static_cast<sf::Int32>(state.gridHeight)
+         << static_cast<sf::Uint8>(protocol::GridEncoding::raw);
+  packet.append(state.grid.data(), state.grid.size());
+}
+
+bool readFrame(sf::Packet &packet, GameState &state) {
+  if (!detail::readPlayers(packet, state)) {
+    return false;
+  }
+  sf::Int32 x = 0, y = 0, width = 0, height = 0;
+  sf::Uint8 encoding = 0;
+  packet >> x >> y >> width >> height >> encoding;
+  if (!packet || x < 0 || y < 0 || width < 0 || height < 0 ||
+      x + width > state.arenaSize.x || y + height > state.arenaSize.y) {
+    return false;
+  }
+  state.windowOffset = {x, y};
+  state.gridWidth = width;
+  state.gridHeight = height;
+  state.grid.resize(static_cast<std::size_t>(width) * height);
+  if (encoding == static_cast<sf::Uint8>(protocol::GridEncoding::tiles)) {
+    if (!detail::readTiles(packet, state)) {
+      return false;
+    }
+  } else {
+    for (auto &cell : state.grid) {
+      packet >> cell;
+    }
+  }
+  if (!packet || !packet.endOfPacket()) {
+    return false;
+  }
+  state.receiveClock.restart();
+  state.updateOccupancy();
+  return true;
+}
+
+void writeDelta(sf::Packet &packet, const GameState &previous,
+                const GameState &state) {
+  packet << static_cast<sf::Int32>(state.frameNumber)
+         << static_cast<sf::Int32>(previous.frameNumber);
+  detail::writePlayers(packet, state);
+  // A grid of another size is sent as changes from an empty grid
+  const bool sameSize = previous.grid.size() == state.grid.size();
+  sf::Uint32 changes = 0;
+  for (std::size_t index = 0; index < state.grid.size(); ++index) {
+    changes += state.grid[index] != (sameSize ? previous.grid[index] : 0);
+  }
+  packet << changes;
+  for (std::size_t index = 0; index < state.grid.size(); ++index) {
+    if (state.grid[index] != (sameSize ? previous.grid[index] : 0)) {
+      packet << static_cast<sf::Uint32>(index) << state.grid[index];
+    }
+  }
+}
+
+bool readDelta(sf::Packet &packet, GameState &state) {
+  sf::Int32 frame = 0, baseFrame = 0;
+  packet >> frame >> baseFrame;
+  if (!packet || baseFrame != state.frameNumber) {
+    return false;
+  }
+  const auto previousSize = state.grid.size();
+  if (!detail::readPlayers(packet, state)) {
+    return false;
+  }
+  state.frameNumber = frame;
+  state.windowOffset = {0, 0};
+  state.gridWidth = state.arenaSize.x;
+  state.gridHeight = state.arenaSize.y;
+  const auto size = static_cast<std::size_t>(state.gridWidth) * state.gridHeight;
+  if (size != previousSize) {
+    state.grid.assign(size, 0);
+  }
+  sf::Uint32 changes = 0;
+  packet >> changes;
+  for (sf::Uint32 change = 0; change < changes; ++change) {
+    sf::Uint32 index = 0;
+    Id value = 0;
+    packet >> index >> value;
+    if (!packet || index >= size) {
+      return false;
+    }
+    state.grid[index] = value;
+  }
+  if (!packet.endOfPacket()) {
+    return false;
+  }
+  state.receiveClock.restart();
+  state.updateOccupancy();
+  return true;
+}
+
+} // namespace cycles
@@ -0,0 +1,75 @@
+#include "local_connection.h"
+#include <spdlog/spdlog.h>
+#include <thread>
+
+namespace cycles {
+
+LocalConnection::LocalConnection(std::shared_ptr<LocalChannel> channel)
+    : channel(std::move(channel)) {}
+
+LocalConnection::~LocalConnection() {
+  if (channel != nullptr) {
+    close();
+  }
+}
+
+void LocalConnection::sendMove(Direction direction) {
+  sendMove(direction, sf::Time::Zero);
+}
+
+sf::Socket::Status LocalConnection::sendMove(Direction direction,
+                                             sf::Time timeout) {
+  if (frameNumber == lastFrameSent) {
+    spdlog::warn("Trying to send move twice in the same frame, call "
+                 "receiveGameState first");
+    return sf::Socket::Done;
+  }
+  sf::Clock clock;
+  // The match consumes one move per published frame, so the queue can only
+  // fill up if the match is gone
+  while (!channel->moves.push({frameNumber, direction})) {
+    if (!isActive()) {
+      return sf::Socket::Disconnected;
+    }
+    if (timeout != sf::Time::Zero && clock.getElapsedTime() >= timeout) {
+      return sf::Socket::NotReady;
+    }
+    std::this_thread::yield();
+  }
+  lastFrameSent = frameNumber;
+  return sf::Socket::Done;
+}
+
+GameState LocalConnection::receiveGameState() {
+  GameState state;
+  receiveGameState(state, sf::Time::Zero);
+  return state;
+}
+
+sf::Socket::Status LocalConnection::receiveGameState(GameState &state,
+                                                     sf::Time timeout) {
+  std::shared_ptr<const GameState> received;
+  sf::Clock clock;
+  while (!channel->states.pop(received)) {
+    if (!isActive()) {
+      return sf::Socket::Disconnected;
+    }
+    if (timeout != sf::Time::Zero && clock.getElapsedTime() >= timeout) {
+      return sf::Socket::NotReady;
+    }
+    std::this_thread::yield();
+  }
+  frameNumber = received->frameNumber;
+  state = *received;
+  return sf::Socket::Done;
+}
+
+bool LocalConnection::isActive() const {
+  return channel->open.load(std::memory_order_acquire);
+}
+
+void LocalConnection::close() {
+  channel->open.store(false, std::memory_order_release);
+}
+
+} // namespace cycles
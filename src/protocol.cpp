@@ -0,0 +1,115 @@
+#include "protocol.h"
+#include <algorithm>
+#include <cstring>
+
+namespace cycles::protocol {
+
+namespace detail {
+void writeUint16(sf::Uint16 value, std::byte *out) {
+  out[0] = std::byte(value >> 8);
+  out[1] = std::byte(value);
+}
+
+void writeUint32(sf::Uint32 value, std::byte *out) {
+  out[0] = std::byte(value >> 24);
+  out[1] = std::byte(value >> 16);
+  out[2] = std::byte(value >> 8);
+  out[3] = std::byte(value);
+}
+
+sf::Uint16 readUint16(const std::byte *in) {
+  return static_cast<sf::Uint16>((std::to_integer<sf::Uint16>(in[0]) << 8) |
+                                 std::to_integer<sf::Uint16>(in[1]));
+}
+
+sf::Uint32 readUint32(const std::byte *in) {
+  return (std::to_integer<sf::Uint32>(in[0]) << 24) |
+         (std::to_integer<sf::Uint32>(in[1]) << 16) |
+         (std::to_integer<sf::Uint32>(in[2]) << 8) |
+         std::to_integer<sf::Uint32>(in[3]);
+}
+} // namespace detail
+
+void unpackTail(sf::Vector2i head, const sf::Uint8 *data, std::size_t length,
+                std::vector<sf::Vector2i> &tail) {
+  static const sf::Vector2i steps[] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+  tail.resize(length);
+  auto cell = head;
+  for (std::size_t index = 0; index < length; ++index) {
+    cell += steps[(data[index / 4] >> (index % 4 * 2)) & 3];
+    tail[index] = cell;
+  }
+}
+
+void writeFragmentHeader(const FragmentHeader &header, std::byte *out) {
+  detail::writeUint32(header.frame, out);
+  detail::writeUint16(header.index, out + 4);
+  detail::writeUint16(header.count, out + 6);
+}
+
+bool readFragmentHeader(const std::byte *data, std::size_t size,
+                        FragmentHeader &header) {
+  if (size < udpFragmentHeaderSize) {
+    return false;
+  }
+  header.frame = detail::readUint32(data);
+  header.index = detail::readUint16(data + 4);
+  header.count = detail::readUint16(data + 6);
+  return header.frame >= 0 && header.index < header.count;
+}
+
+void writeUdpMove(const UdpMove &move, std::byte *out) {
+  detail::writeUint16(move.move, out);
+  out[2] = std::byte(move.sequence);
+}
+
+bool readUdpMove(const std::byte *data, std::size_t size, UdpMove &move) {
+  if (size != udpMoveSize) {
+    return false;
+  }
+  move.move = detail::readUint16(data);
+  move.sequence = std::to_integer<sf::Uint8>(data[2]);
+  return true;
+}
+
+FrameAssembler::FrameAssembler(std::size_t frameCapacity)
+    : maxFragments((frameCapacity + udpFragmentPayload - 1) /
+                   udpFragmentPayload) {}
+
+bool FrameAssembler::add(const std::byte *data, std::size_t size) {
+  FragmentHeader header;
+  if (!readFragmentHeader(data, size, header) || header.count > maxFragments) {
+    return false;
+  }
+  const auto payload = size - udpFragmentHeaderSize;
+  // Stale fragments: an older frame than the one completed or in progress
+  if (header.frame <= completedFrame || header.frame < assembling) {
+    return false;
+  }
+  if (header.frame > assembling) {
+    assembling = header.frame;
+    missing = header.count;
+    assembledSize = 0;
+    buffer.resize(header.count * udpFragmentPayload);
+    received.assign(header.count, false);
+  }
+  if (header.count != received.size() || received[header.index] ||
+      payload > udpFragmentPayload ||
+      (header.index + 1 < header.count && payload != udpFragmentPayload)) {
+    return false;
+  }
+  std::memcpy(buffer.data() + header.index * udpFragmentPayload,
+              data + udpFragmentHeaderSize, payload);
+  received[header.index] = true;
+  assembledSize = std::max(assembledSize,
+                           header.index * udpFragmentPayload + payload);
+  if (--missing > 0) {
+    return false;
+  }
+  buffer.resize(assembledSize);
+  std::swap(buffer, completed);
+  completedFrame = assembling;
+  return true;
+}
+
+} // namespace cycles::protocol
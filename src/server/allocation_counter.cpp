@@ -0,0 +1,39 @@
+#include "allocation_counter.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+// Replacements of the global allocation functions that count every
+// allocation in cycles_server::threadAllocations. The other forms of
+// operator new (nothrow, array) end up here through the standard library.
+
+void *operator new(std::size_t size) {
+  ++cycles_server::threadAllocations;
+  if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  ++cycles_server::threadAllocations;
+  const auto align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants a non-zero multiple of the alignment
+  const auto bytes = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+  if (void *memory = std::aligned_alloc(align, bytes)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept {
+  std::free(memory);
+}
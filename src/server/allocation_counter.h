@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+
+namespace cycles_server {
+
+// Heap allocations made by the calling thread so far.
+//
+// Only counted in programs that link allocation_counter, which replaces the
+// global operator new; everywhere else it stays 0. Compare two readings to
+// count the allocations of a piece of code, such as a frame.
+inline thread_local std::size_t threadAllocations = 0;
+
+inline std::size_t allocationCount() { return threadAllocations; }
+
+} // namespace cycles_server
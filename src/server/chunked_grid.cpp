@@ -0,0 +1,72 @@
+#include "chunked_grid.h"
+#include <algorithm>
+
+namespace cycles_server {
+
+namespace detail {
+const std::array<cycles::Id, ChunkedGrid::chunkSize> emptyRow{};
+} // namespace detail
+
+ChunkedGrid::ChunkedGrid(int width, int height)
+    : width(width), height(height),
+      chunksPerRow((width + chunkSize - 1) / chunkSize),
+      chunkRows((height + chunkSize - 1) / chunkSize) {
+  chunks.resize(static_cast<std::size_t>(chunksPerRow) * chunkRows);
+  versions.assign(chunks.size(), 0);
+  spare.reserve(maxSpareChunks);
+}
+
+void ChunkedGrid::set(int x, int y, cycles::Id value) {
+  const auto index = chunkIndex(x / chunkSize, y / chunkSize);
+  auto &chunk = chunks[index];
+  if (!chunk) {
+    if (value == 0) {
+      return;
+    }
+    if (spare.empty()) {
+      chunk = std::make_unique<Chunk>();
+    } else {
+      chunk = std::move(spare.back());
+      spare.pop_back();
+    }
+    ++allocated;
+  }
+  auto &cell = chunk->cells[cellIndex(x, y)];
+  if (cell == value) {
+    return;
+  }
+  chunk->occupied += (value != 0) - (cell != 0);
+  cell = value;
+  versions[index] = ++version;
+  if (chunk->occupied == 0) {
+    if (spare.size() < maxSpareChunks) {
+      spare.push_back(std::move(chunk));
+    }
+    chunk.reset();
+    --allocated;
+  }
+}
+
+std::span<const cycles::Id> ChunkedGrid::getRow(int x, int y,
+                                                int length) const {
+  const auto count =
+      static_cast<std::size_t>(std::min(length, chunkSize - x % chunkSize));
+  const auto *chunk = chunks[chunkIndex(x / chunkSize, y / chunkSize)].get();
+  if (!chunk) {
+    return {detail::emptyRow.data(), count};
+  }
+  return {chunk->cells.data() + cellIndex(x, y), count};
+}
+
+void ChunkedGrid::copyTo(std::vector<cycles::Id> &out) const {
+  out.resize(static_cast<std::size_t>(width) * height);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; x += chunkSize) {
+      const auto row = getRow(x, y, width - x);
+      std::copy(row.begin(), row.end(),
+                out.begin() + static_cast<std::size_t>(y) * width + x);
+    }
+  }
+}
+
+} // namespace cycles_server
@@ -0,0 +1,97 @@
+#pragma once
+#include "api.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace cycles_server {
+
+// The arena stored as chunks of chunkSize x chunkSize cells.
+//
+// A chunk is allocated by the first write of a non-empty cell and freed when
+// its last cell is emptied, so an arena costs memory for its trails rather
+// than for its area. Every write stamps its chunk with a new version; readers
+// that keep the version they last saw (getVersion) only revisit the chunks
+// that changed since (forEachChangedChunk). A few freed chunks are kept for
+// the next allocations, so that trails moving back and forth across a chunk
+// border do not allocate.
+class ChunkedGrid {
+public:
+  static constexpr int chunkSize = 64;
+  static constexpr std::size_t maxSpareChunks = 16;
+
+  struct Chunk {
+    std::array<cycles::Id, chunkSize * chunkSize> cells{};
+    int occupied = 0;
+  };
+
+  ChunkedGrid(int width, int height);
+
+  cycles::Id get(int x, int y) const {
+    const auto *chunk = chunks[chunkIndex(x / chunkSize, y / chunkSize)].get();
+    return chunk ? chunk->cells[cellIndex(x, y)] : 0;
+  }
+
+  void set(int x, int y, cycles::Id value);
+
+  int getWidth() const { return width; }
+
+  int getHeight() const { return height; }
+
+  // The cells from (x, y) to the end of the row of its chunk, at most length.
+  // Cells of unallocated chunks read from a shared row of zeros.
+  std::span<const cycles::Id> getRow(int x, int y, int length) const;
+
+  // Copies the grid in row-major order
+  void copyTo(std::vector<cycles::Id> &out) const;
+
+  // The version of the last write, 0 if nothing was ever written
+  std::uint64_t getVersion() const { return version; }
+
+  std::uint64_t getChunkVersion(int chunkX, int chunkY) const {
+    return versions[chunkIndex(chunkX, chunkY)];
+  }
+
+  int getChunksPerRow() const { return chunksPerRow; }
+
+  int getChunkRows() const { return chunkRows; }
+
+  int getAllocatedChunks() const { return allocated; }
+
+  // Calls visit(chunkX, chunkY, chunk) for every chunk written after version
+  // since, with nullptr for chunks that are empty now
+  template <class Visit>
+  void forEachChangedChunk(std::uint64_t since, Visit &&visit) const {
+    for (int chunkY = 0; chunkY < chunkRows; ++chunkY) {
+      for (int chunkX = 0; chunkX < chunksPerRow; ++chunkX) {
+        const auto index = chunkIndex(chunkX, chunkY);
+        if (versions[index] > since) {
+          visit(chunkX, chunkY, static_cast<const Chunk *>(chunks[index].get()));
+        }
+      }
+    }
+  }
+
+private:
+  int width;
+  int height;
+  int chunksPerRow;
+  int chunkRows;
+  int allocated = 0;
+  std::uint64_t version = 0;
+  std::vector<std::unique_ptr<Chunk>> chunks;
+  std::vector<std::uint64_t> versions;
+  std::vector<std::unique_ptr<Chunk>> spare; // freed chunks, all cells 0
+
+  std::size_t chunkIndex(int chunkX, int chunkY) const {
+    return static_cast<std::size_t>(chunkY) * chunksPerRow + chunkX;
+  }
+
+  static std::size_t cellIndex(int x, int y) {
+    return (y % chunkSize) * chunkSize + x % chunkSize;
+  }
+};
+
+} // namespace cycles_server
@@ -34,11 +34,55 @@ namespace cycles_server{
     if (config["enablePostProcessing"]) {
       enablePostProcessing = config["enablePostProcessing"].as<bool>();
     }
+    if (config["enableSharedMemory"]) {
+      enableSharedMemory = config["enableSharedMemory"].as<bool>();
+    }
+    if (config["enableUdp"]) {
+      enableUdp = config["enableUdp"].as<bool>();
+    }
+    if (config["frameInterval"]) {
+      frameInterval = config["frameInterval"].as<int>();
+    }
+    if (config["moveTimeout"]) {
+      moveTimeout = config["moveTimeout"].as<int>();
+    }
+    if (config["maxSpectators"]) {
+      maxSpectators = config["maxSpectators"].as<int>();
+    }
+    if (config["spectatorInterval"]) {
+      spectatorInterval = config["spectatorInterval"].as<int>();
+    }
+    if (config["viewportRadius"]) {
+      viewportRadius = config["viewportRadius"].as<int>();
+    }
+    if (config["timestampTrails"]) {
+      timestampTrails = config["timestampTrails"].as<bool>();
+    }
+    if (config["minSpawnDistance"]) {
+      minSpawnDistance = config["minSpawnDistance"].as<int>();
+    }
+    if (config["uncappedTails"]) {
+      uncappedTails = config["uncappedTails"].as<bool>();
+    }
+    if (config["wrappingBorders"]) {
+      wrappingBorders = config["wrappingBorders"].as<bool>();
+    }
+    if (config["longerTailWinsHeadOn"]) {
+      longerTailWinsHeadOn = config["longerTailWinsHeadOn"].as<bool>();
+    }
 
     std::set<std::string> knownParameters = {"maxClients", "gridWidth",
                                              "gridHeight", "gameWidth",
                                              "gameHeight", "gameBannerHeight",
-					     "enablePostProcessing"};
+					     "enablePostProcessing",
+					     "enableSharedMemory",
+					     "enableUdp", "frameInterval",
+					     "moveTimeout", "maxSpectators",
+					     "spectatorInterval", "viewportRadius",
+					     "timestampTrails", "uncappedTails",
+					     "wrappingBorders",
+					     "longerTailWinsHeadOn",
+					     "minSpawnDistance"};
     // Warn if there are unknown parameters
     for (const auto &it : config) {
       if (knownParameters.find(it.first.as<std::string>()) ==
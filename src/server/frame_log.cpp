@@ -0,0 +1,35 @@
+#include "frame_log.h"
+#include "frame_codec.h"
+#include "protocol.h"
+
+namespace cycles_server {
+
+using cycles::protocol::FrameKind;
+
+FrameLog::FrameLog(int keyframeInterval)
+    : keyframeInterval(keyframeInterval < 1 ? 1 : keyframeInterval) {}
+
+void FrameLog::add(const cycles::GameState &state) {
+  sf::Packet packet;
+  if (empty || static_cast<int>(entries.size()) >= keyframeInterval) {
+    entries.clear();
+    packet << static_cast<sf::Uint8>(FrameKind::keyframe);
+    cycles::writeFrame(packet, state);
+  } else {
+    packet << static_cast<sf::Uint8>(FrameKind::delta);
+    cycles::writeDelta(packet, previous, state);
+  }
+  entries.push_back(std::move(packet));
+  previous = state;
+  empty = false;
+}
+
+std::size_t FrameLog::getReplaySize() const {
+  std::size_t bytes = 0;
+  for (const auto &entry : entries) {
+    bytes += 4 + entry.getDataSize();
+  }
+  return bytes;
+}
+
+} // namespace cycles_server
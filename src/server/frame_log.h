@@ -0,0 +1,41 @@
+#pragma once
+#include "api.h"
+#include <SFML/Network.hpp>
+#include <vector>
+
+namespace cycles_server {
+
+// The frames a relay replays to its subscribers: the latest keyframe and the
+// deltas that followed it, each encoded once and tagged with its
+// protocol::FrameKind. A subscriber that joins, or falls too far behind,
+// receives every entry in order and then one delta per frame.
+class FrameLog {
+  int keyframeInterval;
+  cycles::GameState previous;
+  bool empty = true;
+  std::vector<sf::Packet> entries;
+
+public:
+  // A new keyframe is started every keyframeInterval frames, which bounds
+  // what a new subscriber has to download
+  explicit FrameLog(int keyframeInterval);
+
+  // Encodes a new state, as a delta to the previous one or as a keyframe
+  void add(const cycles::GameState &state);
+
+  // The keyframe followed by the deltas since, empty before the first state
+  const std::vector<sf::Packet> &getEntries() const { return entries; }
+
+  // The entry of the last state added
+  const sf::Packet &getLatest() const { return entries.back(); }
+
+  // The last state added
+  const cycles::GameState &getState() const { return previous; }
+
+  bool isEmpty() const { return empty; }
+
+  // Total size of the entries, what a subscriber downloads to catch up
+  std::size_t getReplaySize() const;
+};
+
+} // namespace cycles_server
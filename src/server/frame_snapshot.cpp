@@ -0,0 +1,39 @@
+#include "frame_snapshot.h"
+
+namespace cycles_server {
+
+SnapshotPublisher::SnapshotPublisher()
+    : latest(std::make_shared<const FrameSnapshot>()) {}
+
+void SnapshotPublisher::publish(Game &game) {
+  std::shared_ptr<FrameSnapshot> snapshot;
+  for (const auto &candidate : pool) {
+    // Neither the latest nor in a reader's hands
+    if (candidate.use_count() == 1) {
+      // Pairs with the release of the reader's last reference
+      std::atomic_thread_fence(std::memory_order_acquire);
+      snapshot = candidate;
+      break;
+    }
+  }
+  if (!snapshot) {
+    snapshot = pool.emplace_back(std::make_shared<FrameSnapshot>());
+  }
+  snapshot->frame = game.getFrame();
+  snapshot->gameOver = game.isGameOver();
+  game.readPlayers([&snapshot](const auto &players) {
+    snapshot->players.resize(players.size());
+    auto out = snapshot->players.begin();
+    for (const auto &[id, player] : players) {
+      out->id = id;
+      out->name = player.name;
+      out->color = player.color;
+      out->position = player.position;
+      ++out;
+    }
+  });
+  std::scoped_lock lock(latestMutex);
+  latest = std::move(snapshot);
+}
+
+} // namespace cycles_server
@@ -0,0 +1,48 @@
+#pragma once
+#include "game_logic.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cycles_server {
+
+// What the renderer draws of a frame besides the trails
+struct FrameSnapshot {
+  struct PlayerView {
+    Id id;
+    std::string name;
+    sf::Color color;
+    sf::Vector2i position;
+  };
+  int frame = 0;
+  bool gameOver = false;
+  std::vector<PlayerView> players;
+};
+
+// Hands a snapshot of every frame to a thread that draws at its own pace
+// (the renderer), which takes the latest one without locking the game: the
+// only lock is held while a pointer is copied.
+//
+// Snapshots are rewritten once no reader holds them any more, so publishing
+// allocates nothing once warm. One thread publishes at a time.
+class SnapshotPublisher {
+  std::vector<std::shared_ptr<FrameSnapshot>> pool;
+  mutable std::mutex latestMutex;
+  std::shared_ptr<const FrameSnapshot> latest;
+
+public:
+  // Starts with an empty snapshot, so there always is a latest one
+  SnapshotPublisher();
+
+  // Copies the players of the game and publishes them
+  void publish(Game &game);
+
+  std::shared_ptr<const FrameSnapshot> getLatest() const {
+    std::scoped_lock lock(latestMutex);
+    return latest;
+  }
+};
+
+} // namespace cycles_server
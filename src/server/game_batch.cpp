@@ -0,0 +1,157 @@
+#include "game_batch.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace cycles_server {
+
+namespace detail {
+// Environments per thread below which more workers do not pay off
+constexpr int minEnvsPerThread = 16;
+} // namespace detail
+
+int GameBatch::rangeCount(int numEnvs, int numThreads) {
+  if (numThreads <= 0) {
+    numThreads =
+        std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+  const int ranges =
+      std::clamp(numEnvs / detail::minEnvsPerThread, 1, numThreads);
+  // Every range gets at least one environment
+  const int chunk = (std::max(numEnvs, 1) + ranges - 1) / ranges;
+  return (std::max(numEnvs, 1) + chunk - 1) / chunk;
+}
+
+Configuration GameBatch::batchConfiguration(Configuration conf,
+                                            int playersPerEnv) {
+  // The spawn lattice is sized for the players of an environment
+  conf.maxClients = std::max(playersPerEnv, 1);
+  return conf;
+}
+
+GameBatch::GameBatch(Configuration conf, int numEnvs, int playersPerEnv,
+                     int numThreads, unsigned int seed)
+    : conf(batchConfiguration(conf, playersPerEnv)), numEnvs(numEnvs),
+      playersPerEnv(playersPerEnv), seed(seed),
+      ids(numEnvs * playersPerEnv, 0), episodes(numEnvs, 0),
+      alive(numEnvs * playersPerEnv, 0), done(numEnvs, 0),
+      ranges(rangeCount(numEnvs, numThreads)), stepStart(ranges),
+      stepEnd(ranges) {
+  if (numEnvs <= 0 || playersPerEnv <= 0) {
+    throw std::invalid_argument("GameBatch needs at least one environment "
+                                "and one player per environment");
+  }
+  // Every player needs a spawn slot, and an id below the wall of timestamp
+  // mode
+  const SpawnAllocator spawns(this->conf.gridWidth, this->conf.gridHeight,
+                              this->conf.minSpawnDistance, playersPerEnv);
+  if (spawns.remaining() < static_cast<std::size_t>(playersPerEnv) ||
+      playersPerEnv >= cycles::wallCell) {
+    throw std::invalid_argument("GameBatch cannot spawn " +
+                                std::to_string(playersPerEnv) +
+                                " players per environment on this grid");
+  }
+  envs.reserve(numEnvs);
+  for (int env = 0; env < numEnvs; ++env) {
+    startEpisode(env);
+  }
+  moveBuffers.resize(ranges);
+  for (auto &moves : moveBuffers) {
+    moves.reserve(playersPerEnv);
+  }
+  for (int range = 1; range < ranges; ++range) {
+    workers.emplace_back(&GameBatch::runWorker, this, range);
+  }
+}
+
+GameBatch::~GameBatch() {
+  stopping = true;
+  if (!workers.empty()) {
+    stepStart.arrive_and_wait();
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void GameBatch::startEpisode(int env) {
+  const unsigned int envSeed =
+      seed ^ (env * 0x9E3779B9u) ^ (++episodes[env] * 0x85EBCA6Bu);
+  // The constructor adds the games, later episodes replace them
+  if (env < static_cast<int>(envs.size())) {
+    envs[env] = Game(conf, envSeed);
+  } else {
+    envs.emplace_back(conf, envSeed);
+  }
+  for (int p = 0; p < playersPerEnv; ++p) {
+    const auto slot = env * playersPerEnv + p;
+    ids[slot] = envs[env].addPlayer("player" + std::to_string(p));
+    alive[slot] = ids[slot] != 0;
+  }
+}
+
+void GameBatch::reset() {
+  for (int env = 0; env < numEnvs; ++env) {
+    startEpisode(env);
+    done[env] = 0;
+  }
+}
+
+void GameBatch::stepRange(int range) {
+  const int chunk = (numEnvs + ranges - 1) / ranges;
+  const int begin = range * chunk;
+  const int end = std::min(numEnvs, begin + chunk);
+  const auto directions = pendingDirections;
+  auto &moves = moveBuffers[range];
+  for (int env = begin; env < end; ++env) {
+    if (done[env]) {
+      // The caller has seen how the episode ended
+      startEpisode(env);
+      done[env] = 0;
+      continue;
+    }
+    auto &game = envs[env];
+    const auto first = env * playersPerEnv;
+    moves.clear();
+    for (int p = 0; p < playersPerEnv; ++p) {
+      if (alive[first + p]) {
+        moves.emplace_back(ids[first + p], directions[first + p]);
+      }
+    }
+    game.movePlayers(moves);
+    game.setFrame(game.getFrame() + 1);
+    for (int p = 0; p < playersPerEnv; ++p) {
+      alive[first + p] = alive[first + p] && game.hasPlayer(ids[first + p]);
+    }
+    done[env] = game.isGameOver();
+  }
+}
+
+void GameBatch::runWorker(int range) {
+  while (true) {
+    stepStart.arrive_and_wait();
+    if (stopping) {
+      return;
+    }
+    stepRange(range);
+    stepEnd.arrive_and_wait();
+  }
+}
+
+void GameBatch::step(std::span<const Direction> directions) {
+  if (directions.size() != alive.size()) {
+    throw std::invalid_argument("GameBatch::step expects one direction per "
+                                "player of every environment");
+  }
+  pendingDirections = directions;
+  if (workers.empty()) {
+    stepRange(0);
+    return;
+  }
+  stepStart.arrive_and_wait();
+  stepRange(0);
+  stepEnd.arrive_and_wait();
+}
+
+} // namespace cycles_server
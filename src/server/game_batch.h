@@ -0,0 +1,85 @@
+#pragma once
+#include "game_logic.h"
+#include <atomic>
+#include <barrier>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace cycles_server {
+
+// Vectorized environment: steps many independent games in lockstep.
+//
+// Player p of environment e has its direction read from
+// directions[e * playersPerEnv + p] and its id given by getPlayerId(e, p).
+// Environments whose game is over after a step are flagged in getDone() and
+// keep their final state, so getAlive() tells who died on that step; the next
+// step resets them in place instead of moving them, ignoring their
+// directions.
+class GameBatch {
+  const Configuration conf;
+  const int numEnvs;
+  const int playersPerEnv;
+  unsigned int seed;
+  std::vector<Game> envs;
+  std::vector<Id> ids; // Laid out like alive, 0 for players that did not spawn
+  std::vector<unsigned int> episodes;
+  std::vector<sf::Uint8> alive;
+  std::vector<sf::Uint8> done;
+  // Workers stepping the other ranges of environments, started once; the
+  // calling thread steps the first range
+  int ranges = 1;
+  std::vector<std::thread> workers;
+  std::barrier<> stepStart;
+  std::barrier<> stepEnd;
+  std::atomic<bool> stopping{false};
+  std::span<const Direction> pendingDirections;
+  std::vector<std::vector<Move>> moveBuffers; // One per range
+
+public:
+  // numThreads <= 0 uses one thread per hardware core
+  GameBatch(Configuration conf, int numEnvs, int playersPerEnv,
+            int numThreads = 0, unsigned int seed = std::random_device()());
+
+  GameBatch(const GameBatch &) = delete;
+  GameBatch &operator=(const GameBatch &) = delete;
+
+  ~GameBatch();
+
+  // Advances every environment by one frame
+  void step(std::span<const Direction> directions);
+
+  // Starts a new episode in every environment
+  void reset();
+
+  Game &getGame(int env) { return envs[env]; }
+
+  // The id of player p of an environment in its current episode
+  Id getPlayerId(int env, int p) const { return ids[env * playersPerEnv + p]; }
+
+  int size() const { return numEnvs; }
+
+  int getPlayersPerEnv() const { return playersPerEnv; }
+
+  // One flag per player, laid out like the directions passed to step
+  const std::vector<sf::Uint8> &getAlive() const { return alive; }
+
+  // One flag per environment, set if its episode ended in the last step
+  // (it is reset by the next one)
+  const std::vector<sf::Uint8> &getDone() const { return done; }
+
+private:
+  static Configuration batchConfiguration(Configuration conf,
+                                          int playersPerEnv);
+
+  // Ranges the environments are split in for numThreads threads
+  static int rangeCount(int numEnvs, int numThreads);
+
+  void stepRange(int range);
+
+  void runWorker(int range);
+
+  void startEpisode(int env);
+};
+
+} // namespace cycles_server
@@ -1,23 +1,16 @@
 #include "game_logic.h"
+#include "rules.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
 #include <map>
 #include <random>
-#include <set>
 #include <spdlog/spdlog.h>
 
 namespace cycles_server {
 
 namespace detail {
 
-template <typename T>
-std::map<Id, T> removeNonExistentPlayers(std::map<Id, T> directions,
-                                         const std::map<Id, Player> &players) {
-  for (auto [id, direction] : directions) {
-    if (players.find(id) == players.end()) {
-      directions.erase(id);
-    }
-  }
-  return directions;
-}
   std::tuple<int, int, int> hslToRgb(float h, float s, float l) {
     float c = (1 - std::abs(2 * l - 1)) * s;
     float x = c * (1 - std::abs(std::fmod(h / 60.0, 2) - 1));
@@ -71,112 +64,213 @@ sf::Color getRandomColor(auto rng) {
 
 } // namespace detail
 
-Id Game::addPlayer(const std::string &name) {
+template <class Rules>
+Engine<Rules>::Engine(const Configuration &conf, unsigned int seed)
+    : EngineBase(conf, seed), dims(conf) {
+  initTrails();
+}
+
+template <class Rules>
+Id Engine<Rules>::addPlayer(const std::string &name) {
   static std::vector<uint32_t> palette = detail::generateColorPalette(300);
+  // In timestamp mode wallCell owns the border cells, so it is no player's id
+  if (conf.timestampTrails && idCounter >= cycles::wallCell) {
+    spdlog::warn("Game: No id left for {}", name);
+    return 0;
+  }
+  const auto spawn = spawns.allocate(
+      rng, [this](sf::Vector2i cell) { return cellOwner(cell.x, cell.y) == 0; });
+  if (!spawn) {
+    spdlog::warn("Game: No room left to spawn {}", name);
+    return 0;
+  }
   gameStarted = true;
   Player newPlayer;
   newPlayer.name = name;
   newPlayer.color = sf::Color(palette[idCounter]);
   newPlayer.id = idCounter;
-  std::uniform_real_distribution<float> dist(0, 1.0);
-  do {
-    newPlayer.position.x = conf.gridWidth * dist(rng);
-    newPlayer.position.y = conf.gridHeight * dist(rng);
-  } while (getCell(newPlayer.position.x, newPlayer.position.y));
-  getCell(newPlayer.position.x, newPlayer.position.y) = newPlayer.id;
+  assert(!conf.timestampTrails || newPlayer.id != cycles::wallCell);
+  newPlayer.position = *spawn;
+  if (!conf.timestampTrails) {
+    // Room for the tail until it outgrows the current maximum
+    newPlayer.tail.reserve(
+        std::min<std::size_t>(Tails::maxLength(frame) + 2,
+                              static_cast<std::size_t>(dims.width) * dims.height));
+  }
+  std::scoped_lock lock(gameMutex);
+  if (conf.timestampTrails) {
+    trails[newPlayer.id] = {0, 0, true};
+    trailCells[trailIndex(newPlayer.position.x, newPlayer.position.y)] = {
+        newPlayer.id, 0};
+    gridStale = true;
+  } else {
+    setCell(newPlayer.position.x, newPlayer.position.y, newPlayer.id);
+  }
   players[idCounter] = newPlayer;
   idCounter++;
   return idCounter - 1;
 }
 
-void Game::removePlayer(Id id) {
+template <class Rules>
+void Engine<Rules>::removePlayer(Id id) {
+  std::scoped_lock lock(gameMutex);
+  erasePlayer(id);
+}
+
+template <class Rules>
+void Engine<Rules>::erasePlayer(Id id) {
   auto player_it = players.find(id);
   if (player_it == players.end()) {
     return;
   }
   auto &player = player_it->second;
-  getCell(player.position.x, player.position.y) = 0;
-  for (auto tail : player.tail) {
-    getCell(tail.x, tail.y) = 0;
+  if (conf.timestampTrails) {
+    // Its cells expire with it
+    trails[id].alive = false;
+    gridStale = true;
+  } else {
+    setCell(player.position.x, player.position.y, 0);
+    for (auto tail : player.tail) {
+      setCell(tail.x, tail.y, 0);
+    }
   }
   players.erase(id);
 }
 
-void Game::movePlayers(std::map<Id, Direction> directions) {
-  if (directions.size() == 0) {
+template <class Rules>
+void Engine<Rules>::movePlayers(std::span<const Move> moves) {
+  if (moves.empty()) {
     return;
   }
-  max_tail_length = 55 + frame / 100;
-  // Sanitize directions
-  directions = detail::removeNonExistentPlayers(directions, players);
-  std::map<Id, sf::Vector2i> newPositions;
-  // Transform directions to positions
-  for (const auto &[id, direction] : directions) {
+  max_tail_length = Tails::maxLength(frame);
+  newPositions.clear();
+  // Transform directions to positions, skipping unknown players
+  for (const auto &[id, direction] : moves) {
     auto it = players.find(id);
     if (it == players.end()) {
       continue;
     }
     const auto &player = it->second;
-    const sf::Vector2i newPos = player.position + getDirectionVector(direction);
+    const auto newPos =
+        Borders::step(player.position, getDirectionVector(direction), dims);
     spdlog::debug(
         "Game: Player {} trying to move to ({},{}) from ({},{}) in frame {}",
         player.name, newPos.x, newPos.y, player.position.x, player.position.y,
         frame);
-    newPositions[id] = newPos;
+    newPositions.emplace_back(id, newPos);
   }
   // Check for collisions
-  auto colliding = checkCollisions(newPositions);
-  for (auto id : colliding) {
-    removePlayer(id);
-    newPositions.erase(id);
+  checkCollisions();
+  std::scoped_lock lock(gameMutex);
+  for (const auto &[id, newPos] : newPositions) {
+    if (colliding[id]) {
+      erasePlayer(id);
+    }
   }
   // Move remaining players
   for (const auto &[id, newPos] : newPositions) {
-    auto it = players.find(id);
-    if (it == players.end()) {
+    if (colliding[id]) {
+      colliding[id] = false;
       continue;
     }
-    auto &player = it->second;
-    getCell(newPos.x, newPos.y) = player.id;
-    if (player.tail.size() > max_tail_length) {
-      getCell(player.tail.back().x, player.tail.back().y) = 0;
-      player.tail.pop_back();
+    auto &player = players.find(id)->second;
+    if (conf.timestampTrails) {
+      moveTrail(player, newPos);
+    } else {
+      setCell(newPos.x, newPos.y, player.id);
+      if (player.tail.size() > max_tail_length) {
+        setCell(player.tail.back().x, player.tail.back().y, 0);
+        player.tail.pop_back();
+      }
+      player.tail.push_front(player.position);
     }
-    player.tail.push_front(player.position);
     player.position = newPos;
   }
 }
 
-bool Game::legalMove(sf::Vector2i newPos) {
-  if (newPos.x < 0 || newPos.x >= conf.gridWidth || newPos.y < 0 ||
-      newPos.y >= conf.gridHeight) {
+template <class Rules>
+void Engine<Rules>::initTrails() {
+  if (!conf.timestampTrails) {
+    return;
+  }
+  // The border belongs to a wall that never dies nor ages
+  const auto stride = static_cast<std::size_t>(dims.width) + 2;
+  trailCells.assign(stride * (dims.height + 2), {cycles::wallCell, 0});
+  for (int y = 0; y < dims.height; ++y) {
+    std::fill_n(trailCells.begin() + trailIndex(0, y), dims.width,
+                TrailCell{});
+  }
+  trails[cycles::wallCell] = {0, std::numeric_limits<sf::Uint32>::max(), true};
+}
+
+template <class Rules>
+void Engine<Rules>::moveTrail(const Player &player, sf::Vector2i newPos) {
+  // Same lengths as the tail lists: one more cell per move, up to one past
+  // the maximum
+  auto &trail = trails[player.id];
+  trail.steps++;
+  trail.length = std::min<sf::Uint32>(trail.length + 1, max_tail_length + 1);
+  trailCells[trailIndex(newPos.x, newPos.y)] = {player.id, trail.steps};
+  gridStale = true;
+}
+
+template <class Rules>
+const ChunkedGrid &Engine<Rules>::getGrid() {
+  if (gridStale) {
+    std::scoped_lock lock(gameMutex);
+    for (int y = 0; y < dims.height; ++y) {
+      for (int x = 0; x < dims.width; ++x) {
+        grid.set(x, y, cellOwner(x, y));
+      }
+    }
+    gridStale = false;
+  }
+  return grid;
+}
+
+template <class Rules>
+bool Engine<Rules>::legalMove(sf::Vector2i newPos) const {
+  // Wrapped moves stay on the grid, and timestamp cells are bordered by
+  // walls, so one read tells it all
+  if (!Borders::wraps && !conf.timestampTrails &&
+      (newPos.x < 0 || newPos.x >= dims.width || newPos.y < 0 ||
+       newPos.y >= dims.height)) {
+    spdlog::debug("Game: Moved out of bounds");
+    return false;
+  }
+  const auto owner = cellOwner(newPos.x, newPos.y);
+  if (owner == cycles::wallCell && conf.timestampTrails) {
     spdlog::debug("Game: Moved out of bounds");
     return false;
   }
-  if (getCell(newPos.x, newPos.y) != 0) {
-    spdlog::debug("Game: Moved where player {} is",
-                  int(getCell(newPos.x, newPos.y)));
+  if (owner != 0) {
+    spdlog::debug("Game: Moved where player {} is", int(owner));
     return false;
   }
   return true;
 }
 
-std::set<Id> Game::checkCollisions(std::map<Id, sf::Vector2i> newPositions) {
-  std::set<Id> colliding;
-  // If two players are trying to go to the same position, remove both
-  for (const auto &[id1, pos1] : newPositions) {
-    for (const auto &[id2, pos2] : newPositions) {
-      if (id1 < id2 && pos1 == pos2) {
+template <class Rules>
+void Engine<Rules>::checkCollisions() {
+  // If two players are trying to go to the same position, remove the ones
+  // the head-on rule kills
+  for (std::size_t i = 0; i < newPositions.size(); ++i) {
+    for (std::size_t j = i + 1; j < newPositions.size(); ++j) {
+      const auto &[id1, pos1] = newPositions[i];
+      const auto &[id2, pos2] = newPositions[j];
+      if (pos1 == pos2) {
         spdlog::debug("Game: Players {} and {} collided", id1, id2);
-        colliding.insert(id1);
-        colliding.insert(id2);
+        const auto length1 = tailLength(players.at(id1));
+        const auto length2 = tailLength(players.at(id2));
+        colliding[id1] = colliding[id1] || HeadOn::kills(length1, length2);
+        colliding[id2] = colliding[id2] || HeadOn::kills(length2, length1);
       }
     }
   }
   // If a player is trying to go to a position where another player is, remove
   // the player
   for (const auto &[id, newPos] : newPositions) {
-    auto player = players[id];
+    const auto &player = players.at(id);
     spdlog::debug(
         "Game: Player {} trying to move to ({},{}) from ({},{}) in frame {}",
         player.name, newPos.x, newPos.y, player.position.x, player.position.y,
@@ -184,10 +278,38 @@ std::set<Id> Game::checkCollisions(std::map<Id, sf::Vector2i> newPositions) {
     if (!legalMove(newPos)) {
       spdlog::debug("Game: Player {} tried to move to an illegal position",
                     player.name);
-      colliding.insert(id);
+      colliding[id] = true;
     }
   }
-  return colliding;
+}
+
+template class Engine<DefaultRules>;
+
+namespace detail {
+// Picks the policy for each rule of RuleSet in turn
+template <class... Chosen>
+std::unique_ptr<EngineBase> makeRuleEngine(const Configuration &conf,
+                                           unsigned int seed) {
+  if constexpr (sizeof...(Chosen) == 0) {
+    return conf.uncappedTails ? makeRuleEngine<UncappedTails>(conf, seed)
+                              : makeRuleEngine<CappedTails>(conf, seed);
+  } else if constexpr (sizeof...(Chosen) == 1) {
+    return conf.wrappingBorders
+               ? makeRuleEngine<Chosen..., WrappingBorders>(conf, seed)
+               : makeRuleEngine<Chosen..., SolidBorders>(conf, seed);
+  } else if constexpr (sizeof...(Chosen) == 2) {
+    return conf.longerTailWinsHeadOn
+               ? makeRuleEngine<Chosen..., HeadOnLongerTailWins>(conf, seed)
+               : makeRuleEngine<Chosen..., HeadOnKillsBoth>(conf, seed);
+  } else {
+    return std::make_unique<Engine<RuleSet<Chosen...>>>(conf, seed);
+  }
+}
+} // namespace detail
+
+std::unique_ptr<EngineBase> makeEngine(const Configuration &conf,
+                                       unsigned int seed) {
+  return detail::makeRuleEngine(conf, seed);
 }
 
 } // namespace cycles_server
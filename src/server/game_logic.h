@@ -1,57 +1,245 @@
 #pragma once
+#include "chunked_grid.h"
+#include "rule_policies.h"
+#include "spawn_allocator.h"
 #include "server.h"
+#include <array>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <random>
-#include <set>
+#include <span>
+#include <utility>
 #include <vector>
 
 namespace cycles_server {
 
+// A player and the direction it moves in
+using Move = std::pair<Id, Direction>;
+
+// The size of the grid, passed to the border policies
+struct GridDims {
+  int width;
+  int height;
+  explicit GridDims(const Configuration &conf)
+      : width(conf.gridWidth), height(conf.gridHeight) {}
+};
+
 // Game Logic
-class Game {
+//
+// The state of a game and the queries that do not depend on the rules. The
+// rules live in Engine, compiled once for each combination of rule policies,
+// so that a frame makes a single virtual call and the per-cell queries
+// inside it are direct calls.
+//
+// With conf.timestampTrails the players keep no tail lists: every cell
+// remembers its owner and the step of its owner that wrote it, and is
+// occupied while the owner lives and the cell is at most the length of the
+// owner's tail behind its head. A move then costs O(1) whatever the length
+// of the tail, and a dead player frees its cells at once. The tails of
+// getPlayers() stay empty, and getGrid() is rebuilt from the cells when it
+// is read, so this mode is meant for headless games such as GameBatch.
+class EngineBase {
+public:
+  virtual ~EngineBase() = default;
+
+  // The id of the new player, 0 if there is no room left to spawn it
+  virtual Id addPlayer(const std::string &name) = 0;
+
+  virtual void removePlayer(Id id) = 0;
+
+  // At most one move per player; moves of unknown players are ignored
+  virtual void movePlayers(std::span<const Move> moves) = 0;
+
+  virtual const ChunkedGrid &getGrid() = 0;
+
+  // The player occupying a cell, 0 if it is free. In timestamp mode the
+  // cells next to the grid can be read too, and hold cycles::wallCell.
+  virtual Id getCell(int x, int y) const = 0;
+
+  // Calls visit(chunkX, chunkY, chunk) for every chunk of the grid written
+  // after version since (nullptr if it is empty now) and returns the current
+  // version. Safe to call while another thread moves the players.
+  template <class Visit>
+  std::uint64_t readChangedChunks(std::uint64_t since, Visit &&visit) {
+    std::scoped_lock lock(gameMutex);
+    grid.forEachChangedChunk(since, visit);
+    return grid.getVersion();
+  }
+
+  auto getPlayers() {
+    std::scoped_lock lock(gameMutex);
+    return players;
+  }
+
+  // Calls visit(players) with the players, without copying them
+  template <class Visit> void readPlayers(Visit &&visit) {
+    std::scoped_lock lock(gameMutex);
+    visit(std::as_const(players));
+  }
+
+  bool hasPlayer(Id id) const { return players.find(id) != players.end(); }
+
+  void setFrame(int frame) { this->frame = frame; }
+
+  int getFrame() const { return frame; }
+
+  const Configuration &getConfiguration() const { return conf; }
+
+  bool isGameOver() const { return gameStarted && players.size() <= 1; }
+
+protected:
+  // A player's trail in timestamp mode
+  struct Trail {
+    sf::Uint32 steps = 0;  // moves made so far
+    sf::Uint32 length = 0; // tail cells behind the head
+    bool alive = false;
+  };
+
+  struct TrailCell {
+    Id owner = 0;
+    sf::Uint32 written = 0; // steps of the owner when it entered the cell
+  };
+
   const Configuration conf;
   uint max_tail_length = 55;
   Id idCounter = 1;
   int frame = 0;
   bool gameStarted = false;
   std::map<Id, Player> players;
-  std::vector<sf::Uint8> grid;
+  ChunkedGrid grid;
+  std::vector<TrailCell> trailCells;
+  std::array<Trail, 256> trails;
+  bool gridStale = false;
   std::mt19937 rng;
+  SpawnAllocator spawns;
+  // Reused by every move, so that a frame allocates nothing
+  std::vector<std::pair<Id, sf::Vector2i>> newPositions;
+  std::array<bool, 256> colliding{};
   std::mutex gameMutex;
 
+  EngineBase(const Configuration &conf, unsigned int seed)
+      : conf(conf), grid(conf.gridWidth, conf.gridHeight), rng(seed),
+        spawns(conf.gridWidth, conf.gridHeight, conf.minSpawnDistance,
+               conf.maxClients) {
+    newPositions.reserve(colliding.size());
+  }
+};
+
+template <class Rules = DefaultRules>
+class Engine final : public EngineBase {
+  using Tails = typename Rules::TailPolicy;
+  using Borders = typename Rules::BorderPolicy;
+  using HeadOn = typename Rules::HeadOnPolicy;
+
+  const GridDims dims;
+
 public:
-  Game(Configuration conf)
-      : conf(conf), grid(conf.gridWidth * conf.gridHeight, 0),
-        rng(std::random_device()()) {}
+  Engine(const Configuration &conf, unsigned int seed);
 
-  Id addPlayer(const std::string &name);
+  Id addPlayer(const std::string &name) override;
 
-  void removePlayer(Id id);
+  void removePlayer(Id id) override;
 
-  void movePlayers(std::map<Id, Direction> directions);
+  void movePlayers(std::span<const Move> moves) override;
 
-  const auto &getGrid() { return grid; }
+  const ChunkedGrid &getGrid() override;
 
-  auto getPlayers() {
-    std::scoped_lock lock(gameMutex);
-    return players;
+  Id getCell(int x, int y) const override { return cellOwner(x, y); }
+
+private:
+  // getCell for the move loop, without virtual dispatch
+  Id cellOwner(int x, int y) const {
+    if (!conf.timestampTrails) {
+      return grid.get(x, y);
+    }
+    const auto &cell = trailCells[trailIndex(x, y)];
+    const auto &trail = trails[cell.owner];
+    return trail.alive && trail.steps - cell.written <= trail.length
+               ? cell.owner
+               : 0;
   }
 
-  void setFrame(int frame) { this->frame = frame; }
+  void setCell(int x, int y, Id id) { grid.set(x, y, id); }
 
-  int getFrame() { return frame; }
+  void erasePlayer(Id id);
 
-  bool isGameOver() { return gameStarted && players.size() <= 1; }
+  void moveTrail(const Player &player, sf::Vector2i newPos);
 
-private:
+  void initTrails();
+
+  // Timestamp cells have a border, so moves need no bounds checks
+  std::size_t trailIndex(int x, int y) const {
+    return static_cast<std::size_t>(y + 1) * (dims.width + 2) + x + 1;
+  }
+
+  bool legalMove(sf::Vector2i newPos) const;
 
-  Id &getCell(int x, int y) { return grid[y * conf.gridWidth + x]; }
+  std::size_t tailLength(const Player &player) const {
+    return conf.timestampTrails ? trails[player.id].length
+                                : player.tail.size();
+  }
+
+  // Flags in colliding the players of newPositions that die
+  void checkCollisions();
+};
+
+extern template class Engine<DefaultRules>;
+
+// The engine for the configured rules
+std::unique_ptr<EngineBase> makeEngine(const Configuration &conf,
+                                       unsigned int seed);
+
+// A game, played by the engine of its rules
+class Game {
+  std::unique_ptr<EngineBase> engine;
+  std::vector<Move> moveBuffer;
+
+public:
+  Game(Configuration conf) : Game(conf, std::random_device()()) {}
 
-  bool legalMove(sf::Vector2i newPos);
+  Game(Configuration conf, unsigned int seed)
+      : engine(makeEngine(conf, seed)) {}
 
-  std::set<Id> checkCollisions(std::map<Id, sf::Vector2i> newPositions);
+  Id addPlayer(const std::string &name) { return engine->addPlayer(name); }
+
+  void removePlayer(Id id) { engine->removePlayer(id); }
+
+  void movePlayers(std::span<const Move> moves) {
+    engine->movePlayers(moves);
+  }
+
+  void movePlayers(const std::map<Id, Direction> &directions) {
+    moveBuffer.assign(directions.begin(), directions.end());
+    engine->movePlayers(moveBuffer);
+  }
+
+  const ChunkedGrid &getGrid() { return engine->getGrid(); }
+
+  Id getCell(int x, int y) const { return engine->getCell(x, y); }
+
+  template <class Visit>
+  std::uint64_t readChangedChunks(std::uint64_t since, Visit &&visit) {
+    return engine->readChangedChunks(since, std::forward<Visit>(visit));
+  }
+
+  auto getPlayers() { return engine->getPlayers(); }
+
+  template <class Visit> void readPlayers(Visit &&visit) {
+    engine->readPlayers(std::forward<Visit>(visit));
+  }
+
+  bool hasPlayer(Id id) const { return engine->hasPlayer(id); }
+
+  void setFrame(int frame) { engine->setFrame(frame); }
+
+  int getFrame() const { return engine->getFrame(); }
+
+  const Configuration &getConfiguration() const {
+    return engine->getConfiguration();
+  }
 
+  bool isGameOver() const { return engine->isGameOver(); }
 };
 
 } // namespace cycles_server
@@ -0,0 +1,56 @@
+#include "handshake.h"
+#include "protocol.h"
+
+namespace cycles_server {
+
+HandshakeRequest readHandshake(sf::Packet &packet) {
+  HandshakeRequest request;
+  packet >> request.name >> request.capabilities;
+  if (request.capabilities & cycles::protocol::udpCapability) {
+    packet >> request.udpPort;
+  }
+  if (request.capabilities & cycles::protocol::spectatorCapability) {
+    packet >> request.interval;
+  }
+  return request;
+}
+
+void writeSpectatorReply(sf::Packet &packet, int interval, bool deltas) {
+  packet << sf::Uint8(0) << sf::Uint8(0) << sf::Uint8(0)
+         << static_cast<sf::Uint8>(cycles::protocol::Transport::tcp)
+         << sf::Uint32(0) << static_cast<sf::Uint16>(interval)
+         << static_cast<sf::Uint8>(deltas);
+}
+
+void PendingHandshakes::poll(sf::TcpListener &listener,
+                             const Handler &handle) {
+  while (static_cast<int>(pending.size()) < capacity) {
+    auto socket = std::make_shared<sf::TcpSocket>();
+    if (listener.accept(*socket) != sf::Socket::Done) {
+      break;
+    }
+    socket->setBlocking(false);
+    pending.push_back({socket, sf::Clock()});
+  }
+  for (auto it = pending.begin(); it != pending.end();) {
+    sf::Packet packet;
+    auto status = it->socket->receive(packet);
+    if (status == sf::Socket::NotReady || status == sf::Socket::Partial) {
+      if (it->clock.getElapsedTime() > timeout) {
+        it->socket->disconnect();
+        it = pending.erase(it);
+      } else {
+        ++it;
+      }
+      continue;
+    }
+    if (status == sf::Socket::Done) {
+      handle(it->socket, readHandshake(packet));
+    } else {
+      it->socket->disconnect();
+    }
+    it = pending.erase(it);
+  }
+}
+
+} // namespace cycles_server
@@ -0,0 +1,54 @@
+#pragma once
+#include <SFML/Network.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cycles_server {
+
+// The first packet of a connection: the name of the bot or spectator, the
+// capabilities it supports and, for spectators, the frame interval it asks
+// for. Older clients only send their name.
+struct HandshakeRequest {
+  std::string name;
+  sf::Uint8 capabilities = 0;
+  sf::Uint16 udpPort = 0;
+  sf::Uint16 interval = 0;
+};
+
+HandshakeRequest readHandshake(sf::Packet &packet);
+
+// The reply to a spectator, with the layout of the reply to players: no
+// color nor shared memory slot, the interval granted and whether deltas are
+// sent
+void writeSpectatorReply(sf::Packet &packet, int interval, bool deltas);
+
+// Connections accepted without blocking whose handshake is read over several
+// calls, so that a slow client does not hold up the frames. The game server
+// uses it once the match has started, the relay all the time.
+class PendingHandshakes {
+public:
+  using Handler = std::function<void(std::shared_ptr<sf::TcpSocket>,
+                                     const HandshakeRequest &)>;
+
+  PendingHandshakes(int capacity, sf::Time timeout)
+      : capacity(capacity), timeout(timeout) {}
+
+  // Accepts the waiting connections and hands those whose handshake arrived
+  // to `handle`. Connections that close or take longer than the timeout are
+  // dropped.
+  void poll(sf::TcpListener &listener, const Handler &handle);
+
+private:
+  struct Pending {
+    std::shared_ptr<sf::TcpSocket> socket;
+    sf::Clock clock;
+  };
+
+  const int capacity;
+  const sf::Time timeout;
+  std::vector<Pending> pending;
+};
+
+} // namespace cycles_server
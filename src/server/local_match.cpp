@@ -0,0 +1,164 @@
+#include "local_match.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <spdlog/spdlog.h>
+#include <thread>
+#include <vector>
+
+namespace cycles_server {
+
+LocalMatch::~LocalMatch() {
+  for (auto &[id, channel] : channels) {
+    channel->open.store(false, std::memory_order_release);
+  }
+}
+
+cycles::LocalConnection LocalMatch::connect(const std::string &name) {
+  auto id = game->addPlayer(name);
+  auto channel = std::make_shared<cycles::LocalChannel>();
+  channel->name = name;
+  if (id == 0) {
+    // No room to spawn: the bot finds its channel closed
+    channel->open.store(false, std::memory_order_release);
+    return cycles::LocalConnection(channel);
+  }
+  channel->id = id;
+  game->readPlayers([&](const auto &players) {
+    channel->color = players.at(id).color;
+  });
+  channels[id] = channel;
+  spdlog::info("Local player connected: {} with id {}", name, id);
+  return cycles::LocalConnection(channel);
+}
+
+std::shared_ptr<const cycles::GameState> LocalMatch::snapshot() {
+  std::shared_ptr<cycles::GameState> state;
+  for (const auto &candidate : states) {
+    if (candidate.use_count() == 1) {
+      // Pairs with the release of the last bot's reference
+      std::atomic_thread_fence(std::memory_order_acquire);
+      state = candidate;
+      break;
+    }
+  }
+  if (!state) {
+    state = states.emplace_back(std::make_shared<cycles::GameState>());
+  }
+  game->getGrid().copyTo(state->grid);
+  state->gridWidth = game->getConfiguration().gridWidth;
+  state->gridHeight = game->getConfiguration().gridHeight;
+  state->frameNumber = frame;
+  state->serverTime = matchClock.getElapsedTime();
+  state->moveBudget = moveTimeout;
+  game->readPlayers([&state](const auto &players) {
+    state->players.resize(players.size());
+    auto out = state->players.begin();
+    for (const auto &[id, player] : players) {
+      out->name = player.name;
+      out->color = player.color;
+      out->position = player.position;
+      out->id = id;
+      // Rounded up so that the next, slightly longer tails fit too
+      out->tail.reserve(std::bit_ceil(player.tail.size()));
+      out->tail.assign(player.tail.begin(), player.tail.end());
+      ++out;
+    }
+  });
+  state->updateOccupancy();
+  return state;
+}
+
+void LocalMatch::closeChannel(Id id) {
+  auto it = channels.find(id);
+  if (it == channels.end()) {
+    return;
+  }
+  it->second->open.store(false, std::memory_order_release);
+  channels.erase(it);
+}
+
+bool LocalMatch::step() {
+  game->setFrame(frame);
+  // Remove bots that have died or hung up
+  gone.clear();
+  for (const auto &[id, channel] : channels) {
+    if (!game->hasPlayer(id) ||
+        !channel->open.load(std::memory_order_acquire)) {
+      gone.push_back(id);
+    }
+  }
+  for (auto id : gone) {
+    spdlog::debug("LocalMatch ({}): Player {} left the match", frame, id);
+    game->removePlayer(id);
+    closeChannel(id);
+  }
+  if (game->isGameOver() || channels.empty()) {
+    for (auto &[id, channel] : channels) {
+      channel->open.store(false, std::memory_order_release);
+    }
+    return false;
+  }
+  // Every bot receives the same immutable snapshot
+  auto state = snapshot();
+  pending.clear();
+  for (const auto &[id, channel] : channels) {
+    if (channel->states.push(state)) {
+      pending.push_back(id);
+    }
+  }
+  moves.clear();
+  sf::Clock clock;
+  while (!pending.empty()) {
+    for (auto it = pending.begin(); it != pending.end();) {
+      auto &channel = channels.at(*it);
+      cycles::LocalMove move;
+      bool answered = false;
+      while (channel->moves.pop(move)) {
+        // Moves decided on an older frame are stale, drop them
+        if (move.frame == frame) {
+          moves.emplace_back(*it, move.direction);
+          answered = true;
+          break;
+        }
+      }
+      if (answered || !channel->open.load(std::memory_order_acquire)) {
+        it = pending.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (moveTimeout != sf::Time::Zero &&
+        clock.getElapsedTime() > moveTimeout) {
+      break;
+    }
+    if (!pending.empty()) {
+      std::this_thread::yield();
+    }
+  }
+  // Bots that did not answer in time are removed, like in the server
+  for (auto it = channels.begin(); it != channels.end();) {
+    const auto id = it->first;
+    ++it;
+    if (std::none_of(moves.begin(), moves.end(),
+                     [id](const Move &move) { return move.first == id; })) {
+      spdlog::info("LocalMatch ({}): Player {} did not send a move", frame,
+                   id);
+      game->removePlayer(id);
+      closeChannel(id);
+    }
+  }
+  game->movePlayers(moves);
+  frame++;
+  return !game->isGameOver();
+}
+
+void LocalMatch::run(int maxFrames) {
+  while ((maxFrames < 0 || frame < maxFrames) && step()) {
+  }
+  for (auto &[id, channel] : channels) {
+    channel->open.store(false, std::memory_order_release);
+  }
+}
+
+} // namespace cycles_server
@@ -0,0 +1,53 @@
+#pragma once
+#include "game_logic.h"
+#include "local_connection.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cycles_server {
+
+// In-process match runner
+class LocalMatch {
+  std::shared_ptr<Game> game;
+  std::map<Id, std::shared_ptr<cycles::LocalChannel>> channels;
+  int frame = 0;
+  sf::Time moveTimeout = sf::Time::Zero;
+  sf::Clock matchClock;
+  // Snapshots are rewritten once no bot holds them any more, and the other
+  // buffers are reused by every step, so that a frame allocates nothing
+  std::vector<std::shared_ptr<cycles::GameState>> states;
+  std::vector<Id> gone;
+  std::vector<Id> pending;
+  std::vector<Move> moves;
+
+public:
+  LocalMatch(std::shared_ptr<Game> game) : game(game) {}
+
+  ~LocalMatch();
+
+  // Adds a player to the game and returns the bot's end of its channel,
+  // closed if the game had no room left to spawn it
+  cycles::LocalConnection connect(const std::string &name);
+
+  // Runs one frame: publishes the state, waits for every bot to answer and
+  // moves the players. Returns false once the game is over.
+  bool step();
+
+  // Steps until the game is over or maxFrames frames have been played
+  void run(int maxFrames = -1);
+
+  // Bots that take longer than this to answer are removed, like timed out
+  // clients in the server. Zero waits forever.
+  void setMoveTimeout(sf::Time timeout) { moveTimeout = timeout; }
+
+  int getFrame() const { return frame; }
+
+private:
+  std::shared_ptr<const cycles::GameState> snapshot();
+
+  void closeChannel(Id id);
+};
+
+} // namespace cycles_server
@@ -0,0 +1,80 @@
+#pragma once
+#include "api.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace cycles_server {
+
+// Per-player move slots through which the threads receiving moves hand them
+// to the game loop without locks.
+//
+// Every slot holds one word with the frame, the sequence number and the
+// direction of the latest move posted for its player. Posting replaces the
+// word unless it holds a newer move for the same frame, and the game loop
+// reads it for the frame it collects. Slots sit on their own cache lines so
+// that threads posting for different players do not contend.
+class MoveBoard {
+  struct alignas(64) Slot {
+    std::atomic<std::uint64_t> move{0}; // (frame + 1) << 16 | sequence << 8 | direction
+    std::atomic<bool> closed{false};
+  };
+
+  std::array<Slot, 256> slots;
+  std::atomic<int> frame{-1};
+
+  static std::uint64_t pack(int frame, std::uint8_t sequence, int direction) {
+    return static_cast<std::uint64_t>(frame + 1) << 16 |
+           static_cast<std::uint64_t>(sequence) << 8 |
+           static_cast<std::uint64_t>(direction);
+  }
+
+public:
+  // Opens a frame: moves are now collected for it (game loop)
+  void setFrame(int frame) { this->frame.store(frame, std::memory_order_release); }
+
+  // The frame moves are collected for (-1 before the first one)
+  int getFrame() const { return frame.load(std::memory_order_acquire); }
+
+  // Posts the move of a player for a frame. A move for an older frame than
+  // the posted one, or for the same frame with an older sequence number
+  // (modulo 256), is dropped; any other replaces the previous one.
+  void post(cycles::Id id, int frame, cycles::Direction direction,
+            std::uint8_t sequence = 0) {
+    auto &slot = slots[id];
+    const auto word = pack(frame, sequence, cycles::getDirectionValue(direction));
+    auto current = slot.move.load(std::memory_order_relaxed);
+    do {
+      const auto posted = current >> 16;
+      const auto next = static_cast<std::uint64_t>(frame + 1);
+      if (posted > next ||
+          (posted == next &&
+           static_cast<std::int8_t>(sequence - ((current >> 8) & 0xFF)) < 0)) {
+        return;
+      }
+    } while (!slot.move.compare_exchange_weak(current, word,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+  }
+
+  // Reads the move of a player if one was posted for exactly that frame
+  bool take(cycles::Id id, int frame, cycles::Direction &direction) const {
+    const auto word = slots[id].move.load(std::memory_order_acquire);
+    if ((word >> 16) != static_cast<std::uint64_t>(frame + 1)) {
+      return false;
+    }
+    direction = cycles::getDirectionFromValue(word & 3);
+    return true;
+  }
+
+  // Tells the receiving threads to ignore a player, e.g. because it died
+  void close(cycles::Id id) {
+    slots[id].closed.store(true, std::memory_order_release);
+  }
+
+  bool isClosed(cycles::Id id) const {
+    return slots[id].closed.load(std::memory_order_acquire);
+  }
+};
+
+} // namespace cycles_server
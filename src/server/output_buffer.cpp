@@ -0,0 +1,52 @@
+#include "output_buffer.h"
+#include <algorithm>
+
+namespace cycles_server {
+
+OutputBuffer::OutputBuffer(std::size_t highWaterMark)
+    : highWaterMark(highWaterMark) {}
+
+bool OutputBuffer::push(const sf::Packet &packet) {
+  const auto bytes = packet.getDataSize();
+  if (size() + 4 + bytes > highWaterMark) {
+    return false;
+  }
+  // Reclaim the written bytes before growing the buffer
+  if (cursor > 0) {
+    data.erase(data.begin(), data.begin() + cursor);
+    cursor = 0;
+  }
+  const auto length = static_cast<sf::Uint32>(bytes);
+  data.push_back(std::byte(length >> 24));
+  data.push_back(std::byte(length >> 16));
+  data.push_back(std::byte(length >> 8));
+  data.push_back(std::byte(length));
+  const auto *begin = static_cast<const std::byte *>(packet.getData());
+  data.insert(data.end(), begin, begin + bytes);
+  return true;
+}
+
+sf::Socket::Status OutputBuffer::flush(sf::TcpSocket &socket) {
+  while (!empty()) {
+    std::size_t sent = 0;
+    auto status = socket.send(data.data() + cursor, size(), sent);
+    consume(sent);
+    if (status == sf::Socket::NotReady || status == sf::Socket::Partial) {
+      return sf::Socket::Partial;
+    }
+    if (status != sf::Socket::Done) {
+      return status;
+    }
+  }
+  return sf::Socket::Done;
+}
+
+void OutputBuffer::consume(std::size_t bytes) {
+  cursor += std::min(bytes, size());
+  if (cursor == data.size()) {
+    data.clear();
+    cursor = 0;
+  }
+}
+
+} // namespace cycles_server
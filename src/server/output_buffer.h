@@ -0,0 +1,49 @@
+#pragma once
+#include <SFML/Network.hpp>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace cycles_server {
+
+// Bytes waiting to be written to the non-blocking TCP socket of a client.
+//
+// Packets are framed the way sf::TcpSocket frames them (a big-endian 32-bit
+// size followed by the data), so clients keep reading them with
+// receive(sf::Packet&). When the socket only takes part of the bytes the
+// write cursor stays where it stopped and the next flush resumes from there,
+// so nothing is ever sent twice.
+class OutputBuffer {
+  std::vector<std::byte> data;
+  std::size_t cursor = 0;
+  std::size_t highWaterMark;
+
+public:
+  explicit OutputBuffer(std::size_t highWaterMark);
+
+  // Queues a packet. If the bytes still waiting plus the packet would go over
+  // the high-water mark nothing is queued and false is returned: the client
+  // is not keeping up with the frames.
+  bool push(const sf::Packet &packet);
+
+  // Writes as much as the socket takes without blocking. Returns Done once
+  // everything is written, Partial while bytes are left, and Disconnected or
+  // Error if the socket failed.
+  sf::Socket::Status flush(sf::TcpSocket &socket);
+
+  // The bytes not written yet
+  std::span<const std::byte> pending() const {
+    return {data.data() + cursor, data.size() - cursor};
+  }
+
+  // Marks bytes at the front as written
+  void consume(std::size_t bytes);
+
+  std::size_t size() const { return data.size() - cursor; }
+
+  bool empty() const { return cursor == data.size(); }
+
+  std::size_t getHighWaterMark() const { return highWaterMark; }
+};
+
+} // namespace cycles_server
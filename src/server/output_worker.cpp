@@ -0,0 +1,110 @@
+#include "output_worker.h"
+#include <chrono>
+
+namespace cycles_server {
+
+OutputWorker::Stream::Stream(std::shared_ptr<sf::TcpSocket> socket,
+                             std::size_t highWaterMark)
+    : socket(std::move(socket)), buffer(highWaterMark) {}
+
+std::size_t OutputWorker::Stream::size() {
+  std::scoped_lock lock(mutex);
+  return buffer.size();
+}
+
+void OutputWorker::Stream::disconnect() {
+  std::scoped_lock lock(mutex);
+  closed.store(true, std::memory_order_release);
+  failed.store(true, std::memory_order_release);
+  if (socket != nullptr) {
+    socket->disconnect();
+    socket.reset();
+  }
+}
+
+std::shared_ptr<OutputWorker::Stream>
+OutputWorker::add(std::shared_ptr<sf::TcpSocket> socket,
+                  std::size_t highWaterMark) {
+  return streams.emplace_back(
+      std::make_shared<Stream>(std::move(socket), highWaterMark));
+}
+
+bool OutputWorker::push(Stream &stream, int frame, const sf::Packet &packet) {
+  {
+    std::scoped_lock lock(stream.mutex);
+    if (!stream.buffer.push(packet)) {
+      return false;
+    }
+    stream.queuedFrame = frame;
+  }
+  {
+    std::scoped_lock lock(wakeMutex);
+    queued = true;
+  }
+  wake.notify_one();
+  return true;
+}
+
+void OutputWorker::close(Stream &stream) {
+  stream.closed.store(true, std::memory_order_release);
+}
+
+void OutputWorker::start() {
+  running = true;
+  thread = std::thread(&OutputWorker::run, this);
+}
+
+void OutputWorker::stop() {
+  if (!thread.joinable()) {
+    return;
+  }
+  {
+    std::scoped_lock lock(wakeMutex);
+    running = false;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+bool OutputWorker::writeAll() {
+  bool blocked = false;
+  for (auto &stream : streams) {
+    std::scoped_lock lock(stream->mutex);
+    if (stream->socket == nullptr) {
+      continue;
+    }
+    if (stream->closed.load(std::memory_order_acquire)) {
+      stream->socket.reset();
+      continue;
+    }
+    if (stream->buffer.empty()) {
+      continue;
+    }
+    const auto status = stream->buffer.flush(*stream->socket);
+    if (status == sf::Socket::Done) {
+      stream->writtenFrame.store(stream->queuedFrame,
+                                 std::memory_order_release);
+    } else if (status == sf::Socket::Partial) {
+      blocked = true;
+    } else {
+      stream->failed.store(true, std::memory_order_release);
+      stream->socket.reset();
+    }
+  }
+  return blocked;
+}
+
+void OutputWorker::run() {
+  while (running) {
+    const bool blocked = writeAll();
+    std::unique_lock lock(wakeMutex);
+    // Full sockets are retried soon, otherwise only new frames wake us
+    wake.wait_for(lock,
+                  blocked ? std::chrono::microseconds(200)
+                          : std::chrono::milliseconds(10),
+                  [this] { return queued || !running; });
+    queued = false;
+  }
+}
+
+} // namespace cycles_server
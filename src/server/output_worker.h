@@ -0,0 +1,84 @@
+#pragma once
+#include "output_buffer.h"
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cycles_server {
+
+// Writes the frames queued for TCP clients on a thread of its own.
+//
+// The game loop encodes a frame and queues it on the stream of every client;
+// the worker starts writing as soon as it is queued, while the game loop goes
+// on with the next clients, the moves and the next frame. Frames a slow
+// client has not taken yet keep being written in the background.
+class OutputWorker {
+public:
+  // The output of one client, shared by the game loop and the worker
+  class Stream {
+    friend class OutputWorker;
+    std::shared_ptr<sf::TcpSocket> socket; ///< Written to by the worker only
+    std::mutex mutex; ///< Guards socket, buffer and queuedFrame
+    OutputBuffer buffer;
+    int queuedFrame = -1;
+    std::atomic<int> writtenFrame{-1};
+    std::atomic<bool> failed{false};
+    std::atomic<bool> closed{false};
+
+  public:
+    Stream(std::shared_ptr<sf::TcpSocket> socket, std::size_t highWaterMark);
+
+    // The last frame completely written to the socket
+    int getWrittenFrame() const {
+      return writtenFrame.load(std::memory_order_acquire);
+    }
+
+    // Writing failed: the client is gone
+    bool hasFailed() const { return failed.load(std::memory_order_acquire); }
+
+    // The bytes not written yet
+    std::size_t size();
+
+    // Closes the connection from any thread, after the write in progress.
+    // Nothing is written to the stream afterwards, and it reads as failed.
+    void disconnect();
+  };
+
+  OutputWorker() = default;
+
+  ~OutputWorker() { stop(); }
+
+  // Adds the stream of a client, before the worker starts
+  std::shared_ptr<Stream> add(std::shared_ptr<sf::TcpSocket> socket,
+                              std::size_t highWaterMark);
+
+  // Queues a frame on a stream (game loop). If the stream is too far behind
+  // nothing is queued and false is returned, see OutputBuffer::push.
+  bool push(Stream &stream, int frame, const sf::Packet &packet);
+
+  // Stops writing to a stream (game loop); the worker releases its socket
+  void close(Stream &stream);
+
+  void start();
+
+  void stop();
+
+private:
+  std::vector<std::shared_ptr<Stream>> streams;
+  std::thread thread;
+  std::atomic<bool> running{false};
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  bool queued = false; ///< Something was pushed since the last pass (wakeMutex)
+
+  void run();
+
+  // Writes what each stream takes, true if some socket is full
+  bool writeAll();
+};
+
+} // namespace cycles_server
@@ -0,0 +1,195 @@
+// Fans a match out to many spectators. The relay connects once to the game
+// server, or to another relay, as a spectator and serves the frames to its
+// own spectators with the same handshake, so the spectator load can be
+// spread over as many processes and hosts as needed.
+//
+// Usage: relay <port> [keyframe interval] [max spectators]
+// The upstream server is given by CYCLES_HOST and CYCLES_PORT like for bots.
+#include "api.h"
+#include "frame_codec.h"
+#include "frame_log.h"
+#include "handshake.h"
+#include "output_buffer.h"
+#include "protocol.h"
+#include "spectator_feed.h"
+#include <SFML/Network.hpp>
+#include <algorithm>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+using namespace cycles_server;
+
+struct Subscriber {
+  std::shared_ptr<sf::TcpSocket> socket;
+  std::string name;
+  bool deltas = false;
+  // Spectators taking deltas: the frames not written yet, null until the
+  // keyframe and the deltas since were queued
+  std::unique_ptr<OutputBuffer> output;
+  bool stale = false; ///< Missed a delta, resynchronized once output drains
+  // Other spectators: the shared complete frames
+  SpectatorFeed::Subscription subscription{1};
+};
+
+class Relay {
+  sf::TcpListener listener;
+  FrameLog log;
+  SpectatorFeed feed;
+  const int maxSubscribers;
+  std::vector<Subscriber> subscribers;
+  PendingHandshakes handshakes;
+  int fullSubscribers = 0;
+
+public:
+  Relay(int keyframeInterval, int maxSubscribers)
+      : log(keyframeInterval), maxSubscribers(maxSubscribers),
+        handshakes(maxSubscribers, sf::seconds(5)) {}
+
+  bool listen(unsigned short port) {
+    if (listener.listen(port) != sf::Socket::Done) {
+      return false;
+    }
+    listener.setBlocking(false);
+    return true;
+  }
+
+  void run(cycles::Connection &upstream) {
+    cycles::GameState state;
+    while (upstream.isActive()) {
+      auto status = upstream.receiveGameState(state, sf::milliseconds(5));
+      if (status == sf::Socket::Done) {
+        relay(state);
+      } else if (status != sf::Socket::NotReady) {
+        break;
+      }
+      acceptSubscribers();
+      flush();
+    }
+    spdlog::info("Relay: The upstream server closed the connection");
+  }
+
+private:
+  void relay(const cycles::GameState &state) {
+    log.add(state);
+    // Both encodings are made once, whatever the number of spectators
+    if (fullSubscribers > 0) {
+      sf::Packet frame;
+      cycles::writeFrame(frame, state);
+      feed.publish(state.frameNumber, frame);
+    }
+    for (auto &subscriber : subscribers) {
+      if (subscriber.output != nullptr && !subscriber.stale &&
+          !subscriber.output->push(log.getLatest())) {
+        spdlog::debug("Relay: Spectator {} is not keeping up", subscriber.name);
+        subscriber.stale = true;
+      }
+    }
+  }
+
+  // Queues the keyframe and the deltas since, from which the spectator
+  // follows the deltas of the next frames
+  void synchronize(Subscriber &subscriber) {
+    subscriber.output = std::make_unique<OutputBuffer>(
+        2 * log.getReplaySize() + (1 << 20));
+    for (const auto &entry : log.getEntries()) {
+      subscriber.output->push(entry);
+    }
+    subscriber.stale = false;
+  }
+
+  void flush() {
+    for (auto it = subscribers.begin(); it != subscribers.end();) {
+      auto &subscriber = *it;
+      auto status = sf::Socket::Done;
+      if (!subscriber.deltas) {
+        status = feed.flush(subscriber.subscription, *subscriber.socket);
+      } else if (!log.isEmpty()) {
+        if (subscriber.output == nullptr) {
+          synchronize(subscriber);
+        }
+        status = subscriber.output->flush(*subscriber.socket);
+        // Only whole frames were written, so a keyframe can start here
+        if (status == sf::Socket::Done && subscriber.stale) {
+          synchronize(subscriber);
+        }
+      }
+      if (status == sf::Socket::Disconnected || status == sf::Socket::Error) {
+        spdlog::info("Relay: Spectator {} has disconnected", subscriber.name);
+        fullSubscribers -= !subscriber.deltas;
+        it = subscribers.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void acceptSubscribers() {
+    handshakes.poll(listener, [this](auto socket, const auto &request) {
+      addSubscriber(socket, request);
+    });
+  }
+
+  void addSubscriber(std::shared_ptr<sf::TcpSocket> socket,
+                     const HandshakeRequest &request) {
+    const auto &name = request.name;
+    const auto capabilities = request.capabilities;
+    if (!(capabilities & cycles::protocol::spectatorCapability) ||
+        static_cast<int>(subscribers.size()) >= maxSubscribers) {
+      spdlog::info("Relay: Refusing {}: only spectators can connect", name);
+      socket->disconnect();
+      return;
+    }
+    Subscriber subscriber;
+    subscriber.socket = socket;
+    subscriber.name = name;
+    subscriber.deltas = (capabilities & cycles::protocol::deltaCapability) != 0;
+    const int interval =
+        subscriber.deltas ? 1 : std::max<int>(request.interval, 1);
+    subscriber.subscription = SpectatorFeed::Subscription(interval);
+    // Same reply as the game server, telling whether deltas are sent
+    sf::Packet reply;
+    writeSpectatorReply(reply, interval, subscriber.deltas);
+    socket->setBlocking(true);
+    if (socket->send(reply) != sf::Socket::Done) {
+      socket->disconnect();
+      return;
+    }
+    socket->setBlocking(false);
+    if (!subscriber.deltas && fullSubscribers++ == 0 && !log.isEmpty()) {
+      // Nothing was published while no spectator wanted complete frames
+      sf::Packet frame;
+      cycles::writeFrame(frame, log.getState());
+      feed.publish(log.getState().frameNumber, frame);
+    }
+    spdlog::info("Relay: New spectator {} ({})", name,
+                 subscriber.deltas ? "deltas"
+                                   : "every " + std::to_string(interval) +
+                                         " frames");
+    subscribers.push_back(std::move(subscriber));
+  }
+};
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    spdlog::critical("Usage: relay <port> [keyframe interval] [max spectators]");
+    return 1;
+  }
+  const unsigned short port = std::stoi(argv[1]);
+  const int keyframeInterval = argc > 2 ? std::stoi(argv[2]) : 100;
+  const int maxSubscribers = argc > 3 ? std::stoi(argv[3]) : 1000;
+  Relay relay(keyframeInterval, maxSubscribers);
+  if (!relay.listen(port)) {
+    spdlog::critical("Failed to bind to port {}", port);
+    return 1;
+  }
+  cycles::Connection upstream;
+  if (!upstream.spectate("relay:" + std::to_string(port))) {
+    spdlog::critical("Failed to connect to the upstream server");
+    return 1;
+  }
+  spdlog::info("Relaying on port {}", port);
+  relay.run(upstream);
+  return 0;
+}
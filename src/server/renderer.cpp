@@ -1,6 +1,8 @@
 #include "renderer.h"
 #include "resources.h"
 #include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <memory>
 #include <spdlog/spdlog.h>
@@ -70,13 +72,19 @@ GameRenderer::GameRenderer(Configuration conf)
     spdlog::warn("No font loaded. Text rendering may not work correctly.");
   }
   renderTexture.create(window.getSize().x, window.getSize().y);
+  chunksPerRow =
+      (conf.gridWidth + ChunkedGrid::chunkSize - 1) / ChunkedGrid::chunkSize;
+  chunkRows =
+      (conf.gridHeight + ChunkedGrid::chunkSize - 1) / ChunkedGrid::chunkSize;
+  trails.resize(static_cast<std::size_t>(chunksPerRow) * chunkRows);
+  chunkPixels.resize(ChunkedGrid::chunkSize * ChunkedGrid::chunkSize * 4);
   if (conf.enablePostProcessing) {
     postProcess = std::make_unique<PostProcess>();
     postProcess->create(sf::Vector2i(window.getSize().x, window.getSize().y));
   }
 }
 
-void GameRenderer::render(std::shared_ptr<Game> game) {
+void GameRenderer::render(const FrameSnapshot &snapshot, Game &game) {
   window.clear(sf::Color::Black);
   // // Draw grid
   // sf::RectangleShape cell(sf::Vector2f(conf.cellSize - 1, conf.cellSize -
@@ -87,11 +95,11 @@ void GameRenderer::render(std::shared_ptr<Game> game) {
   // 	window.draw(cell);
   //   }
   // }
-  renderPlayers(game);
-  if (game->isGameOver()) {
-    renderGameOver(game);
+  renderPlayers(snapshot, game);
+  if (snapshot.gameOver) {
+    renderGameOver(snapshot);
   }
-  renderBanner(game);
+  renderBanner(snapshot);
   window.display();
 }
 
@@ -112,7 +120,61 @@ void GameRenderer::handleEvents(
   }
 }
 
-void GameRenderer::renderPlayers(std::shared_ptr<Game> game) {
+void GameRenderer::updateTrails(const FrameSnapshot &snapshot, Game &game) {
+  for (const auto &player : snapshot.players) {
+    colors[player.id] = player.color;
+  }
+  // Only the chunks written since the last frame are converted, and they
+  // are uploaded once the game is unlocked so the game loop never waits on
+  // the graphics driver
+  uploads.clear();
+  std::size_t used = 0;
+  trailsVersion = game.readChangedChunks(
+      trailsVersion,
+      [&](int chunkX, int chunkY, const ChunkedGrid::Chunk *chunk) {
+        const auto index =
+            static_cast<std::size_t>(chunkY) * chunksPerRow + chunkX;
+        if (chunk == nullptr) {
+          uploads.push_back({index, 0, 0, used});
+          return;
+        }
+        const int x0 = chunkX * ChunkedGrid::chunkSize;
+        const int y0 = chunkY * ChunkedGrid::chunkSize;
+        const int width = std::min(ChunkedGrid::chunkSize, conf.gridWidth - x0);
+        const int height =
+            std::min(ChunkedGrid::chunkSize, conf.gridHeight - y0);
+        uploads.push_back({index, width, height, used});
+        used += static_cast<std::size_t>(width) * height * 4;
+        if (chunkPixels.size() < used) {
+          chunkPixels.resize(used);
+        }
+        auto *pixel = chunkPixels.data() + uploads.back().offset;
+        for (int y = 0; y < height; ++y) {
+          for (int x = 0; x < width; ++x) {
+            const Id id = chunk->cells[y * ChunkedGrid::chunkSize + x];
+            const auto color = id ? colors[id] : sf::Color::Transparent;
+            *pixel++ = color.r;
+            *pixel++ = color.g;
+            *pixel++ = color.b;
+            *pixel++ = color.a;
+          }
+        }
+      });
+  for (const auto &upload : uploads) {
+    auto &texture = trails[upload.index];
+    if (upload.width == 0) {
+      texture.reset();
+      continue;
+    }
+    if (texture == nullptr) {
+      texture = std::make_unique<sf::Texture>();
+      texture->create(upload.width, upload.height);
+    }
+    texture->update(chunkPixels.data() + upload.offset);
+  }
+}
+
+void GameRenderer::renderPlayers(const FrameSnapshot &snapshot, Game &game) {
   const int offset_y = conf.gameBannerHeight + 0;
   const int offset_x = 0;
   auto cellSize = conf.cellSize;
@@ -121,8 +183,31 @@ void GameRenderer::renderPlayers(std::shared_ptr<Game> game) {
   sf::RectangleShape bkg(windowSize);
   bkg.setFillColor(sf::Color::Black);
   renderTexture.draw(bkg);
+  // Trails (and heads, drawn over below) straight from the grid
+  updateTrails(snapshot, game);
+  // Only the chunks in the window are drawn
+  const float chunkSide = ChunkedGrid::chunkSize * cellSize;
+  const int visibleColumns = std::min(
+      chunksPerRow, static_cast<int>(std::ceil(conf.gameWidth / chunkSide)));
+  const int visibleRows = std::min(
+      chunkRows, static_cast<int>(std::ceil(conf.gameHeight / chunkSide)));
+  sf::Sprite trailSprite;
+  trailSprite.setScale(cellSize, cellSize);
+  for (int chunkY = 0; chunkY < visibleRows; ++chunkY) {
+    for (int chunkX = 0; chunkX < visibleColumns; ++chunkX) {
+      const auto &texture =
+          trails[static_cast<std::size_t>(chunkY) * chunksPerRow + chunkX];
+      if (texture == nullptr) {
+        continue;
+      }
+      trailSprite.setTexture(*texture, true);
+      trailSprite.setPosition(offset_x + chunkX * chunkSide,
+                              offset_y + chunkY * chunkSide);
+      renderTexture.draw(trailSprite);
+    }
+  }
 
-  for (const auto &[id, player] : game->getPlayers()) {
+  for (const auto &player : snapshot.players) {
     sf::CircleShape playerShape(cellSize);
     // Make the head of the player darker
     auto darkerColor = player.color;
@@ -143,21 +228,13 @@ void GameRenderer::renderPlayers(std::shared_ptr<Game> game) {
         (player.position.x) * cellSize - cellSize / 2 - 1 + offset_x,
         (player.position.y) * cellSize - cellSize / 2 - 1 + offset_y);
     renderTexture.draw(borderShape);
-    // Draw tail
-    for (auto tail : player.tail) {
-      sf::RectangleShape tailShape(sf::Vector2f(cellSize, cellSize));
-      tailShape.setFillColor(player.color);
-      tailShape.setPosition(tail.x * cellSize + offset_x,
-                            tail.y * cellSize + offset_y);
-      renderTexture.draw(tailShape);
-    }
   }
   renderTexture.display();
   if (postProcess)
     postProcess->apply(window, renderTexture);
   else
     window.draw(sf::Sprite(renderTexture.getTexture()));
-  for (const auto &[id, player] : game->getPlayers()) {
+  for (const auto &player : snapshot.players) {
     sf::Text nameText(player.name, font, 30);
     nameText.setFillColor(sf::Color::White);
     nameText.setOutlineThickness(2);
@@ -168,14 +245,14 @@ void GameRenderer::renderPlayers(std::shared_ptr<Game> game) {
   }
 }
 
-void GameRenderer::renderGameOver(std::shared_ptr<Game> game) {
+void GameRenderer::renderGameOver(const FrameSnapshot &snapshot) {
   sf::Text gameOverText("Game Over", font, 60);
   gameOverText.setOutlineThickness(3);
   gameOverText.setOutlineColor(sf::Color::White);
   gameOverText.setFillColor(sf::Color::Black);
   gameOverText.setPosition(conf.gameWidth / 2 - 150, conf.gameHeight / 2 - 30);
-  if (game->getPlayers().size() > 0) {
-    auto winner = game->getPlayers().begin()->second.name;
+  if (snapshot.players.size() > 0) {
+    auto winner = snapshot.players.front().name;
     sf::Text winnerText("Winner: " + winner, font, 40);
     winnerText.setFillColor(sf::Color::Black);
     winnerText.setOutlineThickness(3);
@@ -186,7 +263,7 @@ void GameRenderer::renderGameOver(std::shared_ptr<Game> game) {
   window.draw(gameOverText);
 }
 
-void GameRenderer::renderBanner(std::shared_ptr<Game> game) {
+void GameRenderer::renderBanner(const FrameSnapshot &snapshot) {
   // Draw a banner at the top
   sf::RectangleShape banner(
       sf::Vector2f(conf.gameWidth, conf.gameBannerHeight - 20));
@@ -194,22 +271,23 @@ void GameRenderer::renderBanner(std::shared_ptr<Game> game) {
   banner.setPosition(0, 0);
   window.draw(banner);
   // Draw the frame number
-  sf::Text frameText("Frame: " + std::to_string(game->getFrame()), font, 22);
+  sf::Text frameText("Frame: " + std::to_string(snapshot.frame), font, 22);
   frameText.setPosition(10, 10);
   frameText.setFillColor(sf::Color::White);
   window.draw(frameText);
   // Draw the number of players
-  sf::Text playersText("Players: " + std::to_string(game->getPlayers().size()),
+  sf::Text playersText("Players: " + std::to_string(snapshot.players.size()),
                        font, 22);
   playersText.setPosition(10, 40);
   playersText.setFillColor(sf::Color::White);
   window.draw(playersText);
 }
 
-void GameRenderer::renderSplashScreen(std::shared_ptr<Game> game) {
+void GameRenderer::renderSplashScreen(const FrameSnapshot &snapshot,
+                                      Game &game) {
   window.clear(sf::Color::Black);
-  renderPlayers(game);
-  renderBanner(game);
+  renderPlayers(snapshot, game);
+  renderBanner(snapshot);
   sf::Text splashText("Waiting for players\npress SPACE to start", font, 30);
   splashText.setFillColor(sf::Color::Black);
   splashText.setOutlineThickness(2);
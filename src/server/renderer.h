@@ -1,8 +1,13 @@
 #pragma once
 #include"server.h"
+#include "frame_snapshot.h"
 #include "game_logic.h"
 #include <SFML/Graphics.hpp>
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <vector>
 
 
 namespace cycles_server{
@@ -24,23 +29,43 @@ class GameRenderer {
   sf::RenderTexture renderTexture;
   const Configuration conf;
   std::unique_ptr<PostProcess> postProcess;
+  // The trails, one pixel per cell: a texture per chunk of the grid that
+  // holds cells, created when the chunk is allocated and released when it is
+  // freed, so that video memory follows the trails rather than the arena and
+  // no texture exceeds the size the driver allows
+  std::vector<std::unique_ptr<sf::Texture>> trails;
+  int chunksPerRow = 0;
+  int chunkRows = 0;
+  std::uint64_t trailsVersion = 0;
+  std::vector<sf::Uint8> chunkPixels;
+  std::array<sf::Color, 256> colors;
+  // Chunks converted to pixels under the game's lock, uploaded after it
+  struct ChunkUpload {
+    std::size_t index; // In trails
+    int width, height; // 0 once the chunk is freed
+    std::size_t offset; // In chunkPixels
+  };
+  std::vector<ChunkUpload> uploads;
 
 public:
   GameRenderer(Configuration conf);
 
-  void render(std::shared_ptr<Game> game);
+  // Draws a published frame; only the trails are read from the game
+  void render(const FrameSnapshot &snapshot, Game &game);
 
   bool isOpen() const { return window.isOpen(); }
 
   void handleEvents(std::vector<std::function<void(sf::Event &)>> extraEventHandlers = {});
 
-  void renderSplashScreen(std::shared_ptr<Game> game);
+  void renderSplashScreen(const FrameSnapshot &snapshot, Game &game);
 
 private:
-  void renderPlayers(std::shared_ptr<Game> game);
+  void updateTrails(const FrameSnapshot &snapshot, Game &game);
 
-  void renderGameOver(std::shared_ptr<Game> game);
+  void renderPlayers(const FrameSnapshot &snapshot, Game &game);
 
-  void renderBanner(std::shared_ptr<Game> game);
+  void renderGameOver(const FrameSnapshot &snapshot);
+
+  void renderBanner(const FrameSnapshot &snapshot);
 };
 }
@@ -0,0 +1,73 @@
+#pragma once
+#include "rules.h"
+#include <SFML/System.hpp>
+#include <cstddef>
+#include <limits>
+
+namespace cycles_server {
+
+// Rule policies, chosen per match in the configuration and compiled into the
+// engine so that the move loop has no branches on them (see RuleSet)
+
+// Tails stop growing at cycles::rules::maxTailLength
+struct CappedTails {
+  static sf::Uint32 maxLength(int frame) {
+    return cycles::rules::maxTailLength(frame);
+  }
+};
+
+// Tails grow for the whole match
+struct UncappedTails {
+  static sf::Uint32 maxLength(int) {
+    // One below the maximum, since trails may grow one past it
+    return std::numeric_limits<sf::Uint32>::max() - 1;
+  }
+};
+
+// Moving off the grid kills
+struct SolidBorders {
+  static constexpr bool wraps = false;
+
+  template <class Dims>
+  static sf::Vector2i step(sf::Vector2i from, sf::Vector2i by, const Dims &) {
+    return from + by;
+  }
+};
+
+// Moving off the grid enters it again from the opposite side
+struct WrappingBorders {
+  static constexpr bool wraps = true;
+
+  template <class Dims>
+  static sf::Vector2i step(sf::Vector2i from, sf::Vector2i by,
+                           const Dims &dims) {
+    return {(from.x + by.x + dims.width) % dims.width,
+            (from.y + by.y + dims.height) % dims.height};
+  }
+};
+
+// Players moving into the same cell all die
+struct HeadOnKillsBoth {
+  static constexpr bool kills(std::size_t, std::size_t) { return true; }
+};
+
+// Of the players moving into the same cell, only one with a strictly longer
+// tail than each of the others survives
+struct HeadOnLongerTailWins {
+  static constexpr bool kills(std::size_t length, std::size_t otherLength) {
+    return length <= otherLength;
+  }
+};
+
+template <class Tails = CappedTails, class Borders = SolidBorders,
+          class HeadOn = HeadOnKillsBoth>
+struct RuleSet {
+  using TailPolicy = Tails;
+  using BorderPolicy = Borders;
+  using HeadOnPolicy = HeadOn;
+};
+
+// The rules of the classic game
+using DefaultRules = RuleSet<>;
+
+} // namespace cycles_server
@@ -1,29 +1,109 @@
 #include "server.h"
+#include "allocation_counter.h"
+#include "frame_codec.h"
+#include "frame_snapshot.h"
 #include "game_logic.h"
+#include "handshake.h"
+#include "move_board.h"
+#include "output_worker.h"
+#include "protocol.h"
 #include "renderer.h"
+#include "shared_memory.h"
+#include "spectator_feed.h"
+#include "tile_index.h"
 #include <SFML/Network.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <map>
 #include <memory>
 #include <mutex>
-#include <set>
+#include <optional>
 #include <spdlog/spdlog.h>
 #include <thread>
 #include <vector>
 
 using namespace cycles_server;
+using cycles::protocol::Transport;
+
+struct Client {
+  std::shared_ptr<sf::TcpSocket> socket;
+  std::string name;
+  Transport transport = Transport::tcp;
+  int moveSlot = -1; ///< Slot in the shared frame buffer, if used
+  sf::IpAddress address;
+  unsigned short udpPort = 0; ///< Port the client receives frames on, if used
+  std::shared_ptr<OutputWorker::Stream> output; ///< Frames not yet written to the socket, once the match runs
+  int slowFrames = 0; ///< Consecutive frames skipped because output was full
+  bool broken = false; ///< Writing a frame failed
+};
+
+// The socket a TCP client sends its moves through, read by the input thread
+struct TcpInput {
+  Id id;
+  std::string name;
+  std::shared_ptr<sf::TcpSocket> socket; ///< Released once the client is gone
+  std::shared_ptr<OutputWorker::Stream> output; ///< Its frames, on the same socket
+};
+
+struct Spectator {
+  std::shared_ptr<sf::TcpSocket> socket;
+  std::string name;
+  SpectatorFeed::Subscription subscription;
+};
+
+using UdpEndpoint = std::pair<sf::Uint32, unsigned short>;
 
 // Server Logic
 class GameServer {
   sf::TcpListener listener;
-  std::map<Id, std::shared_ptr<sf::TcpSocket>> clientSockets;
+  std::map<Id, Client> clients;
   std::mutex serverMutex;
   std::shared_ptr<Game> game;
   const Configuration conf;
-  bool running;
+  std::atomic<bool> running;
+  std::unique_ptr<cycles::SharedFrameBuffer> sharedMemory;
+  std::vector<int> freeMoveSlots;
+  sf::UdpSocket udpSocket;
+  bool udpEnabled = false;
+  std::map<UdpEndpoint, Id> udpClients;
+  std::vector<std::byte> datagram;
+  sf::Packet movePacket; // Keeps its buffer from one move to the next
+  // Moves received by the input thread, taken by the game loop. The input
+  // thread owns udpClients, datagram, movePacket and tcpInputs once the
+  // match starts.
+  MoveBoard moveBoard;
+  std::vector<TcpInput> tcpInputs;
+  // Writes the frames of the TCP clients while the game loop moves on
+  OutputWorker outputWorker;
+  // What the renderer draws, published once per frame
+  SnapshotPublisher snapshots;
+  SpectatorFeed spectatorFeed;
+  std::vector<Spectator> spectators;
+  // Connections accepted during the match that have not sent their name yet
+  PendingHandshakes handshakes;
+  TileIndex tileIndex;
+  // Reused by every frame, so that the loop allocates nothing once warm
+  std::vector<Id> toRemove;
+  std::vector<Id> clientsUnsent;
+  std::vector<Id> toReceive;
+  std::vector<Move> newDirs;
+  std::vector<std::pair<Id, sf::Vector2i>> heads;
+  std::vector<sf::Uint8> packedTail;
+  sf::Packet common;
+  sf::Packet whole;
+  sf::Packet window;
 
 public:
   GameServer(std::shared_ptr<Game> game, Configuration conf)
-      : game(game), conf(conf), running(false) {
+      : game(game), conf(conf), running(false),
+        handshakes(conf.maxSpectators, sf::seconds(5)),
+        tileIndex(game->getGrid()) {
+    // Clients need the tails, which timestamp trails do not keep
+    if (conf.timestampTrails) {
+      spdlog::critical("timestampTrails is only available to headless games");
+      exit(1);
+    }
     const char *portenv = std::getenv("CYCLES_PORT");
     if (portenv == nullptr) {
       spdlog::critical("Please set the CYCLES_PORT environment variable");
@@ -37,23 +117,71 @@ public:
       spdlog::critical("Failed to bind to port {}", PORT);
       exit(1);
     }
+    if (conf.enableSharedMemory) {
+      sharedMemory = cycles::SharedFrameBuffer::create(
+          cycles::protocol::sharedMemoryName(PORT), getFrameCapacity(),
+          conf.maxClients);
+      if (sharedMemory != nullptr) {
+        spdlog::info("Publishing frames in shared memory");
+        for (int slot = conf.maxClients - 1; slot >= 0; --slot) {
+          freeMoveSlots.push_back(slot);
+        }
+      }
+    }
+    if (conf.enableUdp) {
+      udpEnabled = udpSocket.bind(PORT) == sf::Socket::Done;
+      if (udpEnabled) {
+        udpSocket.setBlocking(false);
+        datagram.resize(sf::UdpSocket::MaxDatagramSize);
+        spdlog::info("Accepting UDP clients on port {}", PORT);
+      } else {
+        spdlog::warn("Failed to bind UDP port {}, UDP transport disabled",
+                     PORT);
+      }
+    }
+  }
+
+  // Room for a whole frame with every client, see maxFrameSize
+  std::size_t getFrameCapacity() const {
+    return cycles::protocol::maxFrameSize(
+        static_cast<std::size_t>(conf.gridWidth) * conf.gridHeight,
+        conf.maxClients);
   }
 
   void run() {
     running = true;
+    // No client joins once the match runs, so the input thread and the
+    // output worker get their sockets now and never read clients
+    for (auto &[id, client] : clients) {
+      if (client.transport == Transport::tcp) {
+        client.output = outputWorker.add(
+            client.socket, maxBufferedFrames * (4 + getFrameCapacity()));
+        tcpInputs.push_back({id, client.name, client.socket, client.output});
+      }
+    }
+    outputWorker.start();
+    std::thread inputThread(&GameServer::inputLoop, this);
     std::thread gameLoopThread(&GameServer::gameLoop, this);
     gameLoopThread.join();
+    running = false;
+    inputThread.join();
+    outputWorker.stop();
   }
 
   void stop() { running = false; }
 
+  // The latest frame published for the renderer
+  std::shared_ptr<const FrameSnapshot> getSnapshot() const {
+    return snapshots.getLatest();
+  }
+
   int getFrame() const { return frame; }
 
   void setAcceptingClients(bool accepting) { acceptingClients = accepting; }
 
   void acceptClients() {
     while (acceptingClients &&
-           static_cast<int>(clientSockets.size()) < conf.maxClients) {
+           static_cast<int>(clients.size()) < conf.maxClients) {
       auto clientSocket = std::make_shared<sf::TcpSocket>();
       if (listener.accept(*clientSocket) == sf::Socket::Done) {
         clientSocket->setBlocking(
@@ -61,13 +189,51 @@ public:
         // Receive player name
         sf::Packet namePacket;
         if (clientSocket->receive(namePacket) == sf::Socket::Done) {
-          std::string playerName;
-          namePacket >> playerName;
+          const auto request = readHandshake(namePacket);
+          auto playerName = request.name;
+          // Frames are sized for names up to the limit
+          if (playerName.size() > cycles::protocol::maxNameLength) {
+            playerName.resize(cycles::protocol::maxNameLength);
+          }
+          const auto capabilities = request.capabilities;
+          const auto clientUdpPort = request.udpPort;
+          if (capabilities & cycles::protocol::spectatorCapability) {
+            addSpectator(clientSocket, request);
+            continue;
+          }
           auto id = game->addPlayer(playerName);
-          // Send color to the client
+          if (id == 0) {
+            spdlog::warn("No room left to spawn {}, disconnecting it",
+                         playerName);
+            clientSocket->disconnect();
+            continue;
+          }
+          Client client;
+          client.socket = clientSocket;
+          client.name = playerName;
+          client.address = clientSocket->getRemoteAddress();
+          if ((capabilities & cycles::protocol::sharedMemoryCapability) &&
+              sharedMemory != nullptr && !freeMoveSlots.empty()) {
+            client.transport = Transport::sharedMemory;
+            client.moveSlot = freeMoveSlots.back();
+            freeMoveSlots.pop_back();
+            sharedMemory->openSlot(client.moveSlot);
+          } else if ((capabilities & cycles::protocol::udpCapability) &&
+                     udpEnabled && clientUdpPort != 0) {
+            client.transport = Transport::udp;
+            client.udpPort = clientUdpPort;
+            udpClients[{client.address.toInteger(), clientUdpPort}] = id;
+          }
+          // Send color and transport to the client
           sf::Packet colorPacket;
-          const auto &player = game->getPlayers().at(id);
-          colorPacket << player.color.r << player.color.g << player.color.b;
+          const auto color = game->getPlayers().at(id).color;
+          colorPacket << color.r << color.g << color.b;
+          colorPacket << static_cast<sf::Uint8>(client.transport)
+                      << static_cast<sf::Uint32>(std::max(client.moveSlot, 0));
+          if (client.transport == Transport::udp) {
+            colorPacket << static_cast<sf::Uint16>(udpSocket.getLocalPort())
+                        << static_cast<sf::Uint32>(getFrameCapacity());
+          }
           if (clientSocket->send(colorPacket) != sf::Socket::Done) {
             spdlog::critical("Failed to send color to client: {}", playerName);
           } else {
@@ -75,7 +241,8 @@ public:
           }
           clientSocket->setBlocking(
               false); // Set back to non-blocking for game loop
-          clientSockets[id] = clientSocket;
+          clients[id] = client;
+          snapshots.publish(*game);
           spdlog::info("New client connected: {} with id {}", playerName, id);
         }
       }
@@ -84,137 +251,435 @@ public:
 
 private:
   int frame = 0;
-  const int max_client_communication_time = 50; // ms
+  // Frames a TCP client may lag behind before frames are skipped for it
+  static constexpr int maxBufferedFrames = 2;
+  // Frames in a row a client may skip before it is dropped (~1 second)
+  const int max_slow_frames = 30;
 
   bool acceptingClients = true;
+  // Timestamps in frame headers are relative to the server's start
+  sf::Clock serverClock;
+
+  void dropClient(Id id) {
+    auto it = clients.find(id);
+    if (it != clients.end() && it->second.transport == Transport::sharedMemory) {
+      sharedMemory->closeSlot(it->second.moveSlot);
+      freeMoveSlots.push_back(it->second.moveSlot);
+    }
+    // The input thread and the output worker stop using its socket and
+    // release it
+    moveBoard.close(id);
+    if (it != clients.end() && it->second.output != nullptr) {
+      outputWorker.close(*it->second.output);
+    }
+    game->removePlayer(id);
+    clients.erase(id);
+  }
+
+  // Replies to a spectator's handshake and subscribes it to the frames
+  void addSpectator(std::shared_ptr<sf::TcpSocket> socket,
+                    const HandshakeRequest &request) {
+    const auto &name = request.name;
+    if (static_cast<int>(spectators.size()) >= conf.maxSpectators) {
+      spdlog::warn("Refusing spectator {}: too many spectators", name);
+      socket->disconnect();
+      return;
+    }
+    const int interval =
+        std::max(static_cast<int>(request.interval), conf.spectatorInterval);
+    // No deltas, only relays send them
+    sf::Packet reply;
+    writeSpectatorReply(reply, interval, false);
+    socket->setBlocking(true);
+    if (socket->send(reply) != sf::Socket::Done) {
+      spdlog::warn("Failed to reply to spectator {}", name);
+      socket->disconnect();
+      return;
+    }
+    socket->setBlocking(false);
+    spectators.push_back({socket, name, SpectatorFeed::Subscription(interval)});
+    spdlog::info("New spectator connected: {} (every {} frames)", name,
+                 interval);
+  }
+
+  // Once the match has started only spectators may join. Connections are
+  // taken without blocking and their handshake is read over several frames.
+  void acceptSpectators() {
+    handshakes.poll(listener, [this](auto socket, const auto &request) {
+      if (request.capabilities & cycles::protocol::spectatorCapability) {
+        addSpectator(socket, request);
+      } else {
+        spdlog::info("Refusing player {}: the match has started",
+                     request.name);
+        socket->disconnect();
+      }
+    });
+  }
+
+  // Writes the due frame to every spectator without waiting for any of them
+  void flushSpectators() {
+    for (auto it = spectators.begin(); it != spectators.end();) {
+      auto status = spectatorFeed.flush(it->subscription, *it->socket);
+      if (status == sf::Socket::Disconnected || status == sf::Socket::Error) {
+        spdlog::info("Spectator {} has disconnected", it->name);
+        it = spectators.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // The socket of a TCP client belongs to the input thread and the output
+  // worker, which mark its stream as failed once the client is gone. Other
+  // clients' sockets are only used by the game loop.
+  static bool isDisconnected(const Client &client) {
+    if (client.output != nullptr) {
+      return client.output->hasFailed();
+    }
+    return client.socket->getRemoteAddress() == sf::IpAddress::None;
+  }
 
   void checkPlayers() {
-    // Remove sockets from players that have died or disconnected
+    // Remove clients whose players have died or disconnected
     spdlog::debug("Server ({}): Checking players", frame);
-    auto players = game->getPlayers();
-    for (const auto &[id, socket] : clientSockets) {
+    toRemove.clear();
+    for (const auto &[id, client] : clients) {
       bool remove = false;
-      if (players.find(id) == players.end()) {
+      if (!game->hasPlayer(id)) {
         spdlog::info("Player {} has died", id);
         remove = true;
       }
-      if (socket->getRemoteAddress() == sf::IpAddress::None) {
+      if (client.broken || isDisconnected(client)) {
         spdlog::info("Player {} has disconnected", id);
         remove = true;
       }
+      if (client.slowFrames > max_slow_frames) {
+        spdlog::info("Player {} is too slow to keep up with the frames", id);
+        remove = true;
+      }
       if (remove) {
-        game->removePlayer(id);
-        clientSockets.erase(id);
+        toRemove.push_back(id);
+      }
+    }
+    for (auto id : toRemove) {
+      dropClient(id);
+    }
+  }
+
+  // Receives the moves of the TCP and UDP clients and posts them on the
+  // move board, so that the game loop never waits on a socket (input thread)
+  void inputLoop() {
+    sf::SocketSelector selector;
+    for (auto &input : tcpInputs) {
+      selector.add(*input.socket);
+    }
+    if (udpEnabled) {
+      selector.add(udpSocket);
+    }
+    // Stops reading a client and closes its connection
+    auto release = [&selector](TcpInput &input) {
+      selector.remove(*input.socket);
+      input.output->disconnect();
+      input.socket.reset();
+    };
+    while (running) {
+      // Dropped clients are closed at once, even if they send nothing more
+      for (auto &input : tcpInputs) {
+        if (input.socket != nullptr && moveBoard.isClosed(input.id)) {
+          release(input);
+        }
+      }
+      if (!selector.wait(sf::milliseconds(1))) {
+        continue;
+      }
+      for (auto &input : tcpInputs) {
+        if (input.socket == nullptr || !selector.isReady(*input.socket)) {
+          continue;
+        }
+        // Gone clients would keep the selector ready
+        if (!receiveTcpMoves(input)) {
+          release(input);
+        }
+      }
+      if (udpEnabled && selector.isReady(udpSocket)) {
+        receiveDatagrams();
+      }
+    }
+  }
+
+  // Posts the moves queued on a TCP socket, false once it is closed
+  bool receiveTcpMoves(const TcpInput &input) {
+    sf::Socket::Status status;
+    while ((status = input.socket->receive(movePacket)) == sf::Socket::Done) {
+      const int frame = moveBoard.getFrame();
+      sf::Uint16 move;
+      int direction;
+      if (!(movePacket >> move) || !movePacket.endOfPacket()) {
+        spdlog::warn("Server ({}): Malformed move from player {} ({})", frame,
+                     input.id, input.name);
+        continue;
+      }
+      if (!cycles::protocol::decodeMove(move, frame, direction)) {
+        spdlog::debug("Server ({}): Dropped stale move from player {} ({})",
+                      frame, input.id, input.name);
+        continue;
       }
+      spdlog::debug("Received direction {} from player {} ({})", direction,
+                    input.id, input.name);
+      moveBoard.post(input.id, frame, cycles::getDirectionFromValue(direction));
     }
+    return status != sf::Socket::Disconnected && status != sf::Socket::Error;
   }
 
-  auto receiveClientInput(auto clientSockets) {
+  // Posts, for every UDP client, the newest move it sent for the frame
+  void receiveDatagrams() {
+    std::size_t received;
+    sf::IpAddress sender;
+    unsigned short senderPort;
+    while (udpSocket.receive(datagram.data(), datagram.size(), received, sender,
+                             senderPort) == sf::Socket::Done) {
+      const int frame = moveBoard.getFrame();
+      auto client = udpClients.find({sender.toInteger(), senderPort});
+      cycles::protocol::UdpMove move;
+      int direction;
+      // Unknown senders, malformed datagrams and stale moves are dropped
+      if (client == udpClients.end() || moveBoard.isClosed(client->second) ||
+          !cycles::protocol::readUdpMove(datagram.data(), received, move) ||
+          !cycles::protocol::decodeMove(move.move, frame, direction)) {
+        continue;
+      }
+      moveBoard.post(client->second, frame,
+                     cycles::getDirectionFromValue(direction), move.sequence);
+    }
+  }
+
+  void sendDatagrams(const Client &client, const sf::Packet &packet) {
+    const auto *data = static_cast<const std::byte *>(packet.getData());
+    const auto size = packet.getDataSize();
+    const auto count =
+        (size + cycles::protocol::udpFragmentPayload - 1) /
+        cycles::protocol::udpFragmentPayload;
+    std::byte fragment[cycles::protocol::udpFragmentHeaderSize +
+                       cycles::protocol::udpFragmentPayload];
+    for (std::size_t index = 0; index < count; ++index) {
+      const auto offset = index * cycles::protocol::udpFragmentPayload;
+      const auto payload =
+          std::min(cycles::protocol::udpFragmentPayload, size - offset);
+      cycles::protocol::writeFragmentHeader(
+          {frame, static_cast<sf::Uint16>(index),
+           static_cast<sf::Uint16>(count)},
+          fragment);
+      std::memcpy(fragment + cycles::protocol::udpFragmentHeaderSize,
+                  data + offset, payload);
+      // A datagram the kernel drops is just a lost datagram
+      udpSocket.send(fragment,
+                     cycles::protocol::udpFragmentHeaderSize + payload,
+                     client.address, client.udpPort);
+    }
+  }
+
+  // Moves the clients of toReceive whose move arrived to newDirs
+  void receiveClientInput() {
     spdlog::debug("Server ({}): Receiving client input from {} clients", frame,
-                  clientSockets.size());
-    if (clientSockets.size() == 0) {
-      return std::map<Id, Direction>();
+                  toReceive.size());
+    std::erase_if(toReceive, [this](Id id) {
+      const auto &client = clients.at(id);
+      Direction direction;
+      const bool received =
+          client.transport == Transport::sharedMemory
+              ? sharedMemory->takeMove(client.moveSlot, frame, direction)
+              : moveBoard.take(id, frame, direction);
+      if (received) {
+        newDirs.emplace_back(id, direction);
+      }
+      return received;
+    });
+  }
+
+  // Everything but the grid, the same for every client
+  void encodePlayers(const std::map<Id, Player> &players) {
+    common.clear();
+    cycles::writeFrameHeader(common, serverClock.getElapsedTime(),
+                             sf::milliseconds(conf.moveTimeout),
+                             {conf.gridWidth, conf.gridHeight}, players.size());
+    for (const auto &[id, player] : players) {
+      cycles::writePlayer(common, player, frame, packedTail);
     }
-    std::map<Id, Direction> successful;
-    for (const auto &[id, clientSocket] : clientSockets) {
-      auto name = game->getPlayers().at(id).name;
-      spdlog::debug("Server ({}): Receiving input from player {} ({})", frame,
-                    id, name);
-      sf::Packet packet;
-      auto status = clientSocket->receive(packet);
-      if (status == sf::Socket::Done) {
-        int direction;
-        packet >> direction;
-        spdlog::debug("Received direction {} from player {} ({})", direction,
-                      id, name);
-        successful[id] = static_cast<Direction>(direction);
+  }
+
+  // Appends the whole grid, as one window of raw cells
+  void encodeGrid(sf::Packet &packet) {
+    const auto &grid = game->getGrid();
+    packet << sf::Int32(0) << sf::Int32(0) << conf.gridWidth
+           << conf.gridHeight
+           << static_cast<sf::Uint8>(cycles::protocol::GridEncoding::raw);
+    for (int y = 0; y < conf.gridHeight; ++y) {
+      for (int x = 0; x < conf.gridWidth; x += ChunkedGrid::chunkSize) {
+        const auto row = grid.getRow(x, y, conf.gridWidth - x);
+        packet.append(row.data(), row.size());
       }
     }
-    return successful;
   }
 
-  auto sendGameState(auto clientSockets) {
+  // The frame with the area around a player's head, in viewport mode
+  const sf::Packet &encodeViewport(sf::Vector2i head) {
+    window.clear();
+    window.append(common.getData(), common.getDataSize());
+    tileIndex.writeWindow(window,
+                          tileIndex.getWindow(head, conf.viewportRadius));
+    return window;
+  }
+
+  // Hands the frame to every client and lists the clients that will answer
+  // it: TCP clients in clientsUnsent, queued on the output worker, the
+  // others in toReceive. Clients whose buffer is full are skipped for this
+  // frame instead of holding it up.
+  void sendGameState() {
     spdlog::debug("Server ({}): Sending game state to {} clients", frame,
-                  clientSockets.size());
-    if (clientSockets.size() == 0) {
-      return std::vector<Id>();
+                  clients.size());
+    if (clients.size() == 0) {
+      return;
     }
-    sf::Packet packet;
-    packet << conf.gridWidth << conf.gridHeight;
-    const auto &grid = game->getGrid();
-    auto players = game->getPlayers();
-    packet << static_cast<sf::Uint32>(players.size());
-    for (const auto &[id, player] : players) {
-      packet << player.position.x << player.position.y << player.color.r
-             << player.color.g << player.color.b << player.name << id << frame;
+    heads.clear();
+    game->readPlayers([this](const auto &players) {
+      encodePlayers(players);
+      for (const auto &[id, player] : players) {
+        heads.emplace_back(id, player.position);
+      }
+    });
+    const bool viewports = conf.viewportRadius > 0;
+    // The whole grid is only encoded if someone takes it
+    bool wholeEncoded = false;
+    auto wholeFrame = [&]() -> const sf::Packet & {
+      if (!wholeEncoded) {
+        whole.clear();
+        whole.append(common.getData(), common.getDataSize());
+        encodeGrid(whole);
+        wholeEncoded = true;
+      }
+      return whole;
+    };
+    // Spectators share one copy of the frame whatever their number
+    if (!spectators.empty()) {
+      spectatorFeed.publish(frame, wholeFrame());
+      flushSpectators();
     }
-    for (auto &cell : grid) {
-      packet << cell;
+    bool published = false;
+    for (auto &[id, client] : clients) {
+      if (client.transport == Transport::sharedMemory) {
+        // The frame is written once for every local client, and costs no
+        // bandwidth, so it always holds the whole grid
+        if (!published) {
+          const auto &packet = wholeFrame();
+          published = sharedMemory->publishFrame(frame, packet.getData(),
+                                                 packet.getDataSize());
+          if (!published) {
+            spdlog::error("Server ({}): Frame does not fit in shared memory",
+                          frame);
+          }
+        }
+        if (published) {
+          toReceive.push_back(id);
+        }
+        continue;
+      }
+      auto head = std::find_if(heads.begin(), heads.end(),
+                               [id](const auto &head) { return head.first == id; });
+      const auto &packet = viewports && head != heads.end()
+                               ? encodeViewport(head->second)
+                               : wholeFrame();
+      if (client.transport == Transport::udp) {
+        sendDatagrams(client, packet);
+        toReceive.push_back(id);
+        continue;
+      }
+      if (!outputWorker.push(*client.output, frame, packet)) {
+        client.slowFrames++;
+        spdlog::warn("Server ({}): Player {} is not keeping up, skipping frame",
+                     frame, id);
+        continue;
+      }
+      client.slowFrames = 0;
+      clientsUnsent.push_back(id);
     }
-    std::vector<Id> successful;
-    for (const auto &[id, clientSocket] : clientSockets) {
-      if (clientSocket->send(packet) != sf::Socket::Done) {
+  }
+
+  // Moves the clients whose frame the output worker has completely written
+  // to the clients expected to answer
+  void collectWritten() {
+    std::erase_if(clientsUnsent, [this](Id id) {
+      auto &client = clients.at(id);
+      if (client.output->hasFailed()) {
         spdlog::debug("Server ({}): Failed to send game state to player {}",
                       frame, id);
-      } else {
-        successful.push_back(id);
-        spdlog::debug("Server ({}): Game state sent to player {}", frame, id);
+        // Noticed by checkPlayers on the next frame
+        client.broken = true;
+        return true;
       }
-    }
-    return successful;
+      if (client.output->getWrittenFrame() < frame) {
+        return false;
+      }
+      spdlog::debug("Server ({}): Game state sent to player {}", frame, id);
+      toReceive.push_back(id);
+      return true;
+    });
   }
 
   void gameLoop() {
     sf::Clock clock;
     sf::Clock clientCommunicationClock;
     while (running && !game->isGameOver()) {
-      if (clock.getElapsedTime().asMilliseconds() >= 33) { // ~30 fps
+      if (clock.getElapsedTime().asMilliseconds() >= conf.frameInterval) {
         clock.restart();
         std::scoped_lock lock(serverMutex);
         game->setFrame(frame);
+        moveBoard.setFrame(frame);
+        acceptSpectators();
         checkPlayers();
-        auto clientsUnsent = clientSockets;
-        decltype(clientSockets) toRecieve;
-        std::map<Id, Direction> newDirs;
-        std::set<Id> timedOutPlayers;
+#ifdef CYCLES_COUNT_ALLOCATIONS
+        const auto allocations = allocationCount();
+#endif
+        clientsUnsent.clear();
+        toReceive.clear();
+        newDirs.clear();
+        // The move deadline advertised in the frame header starts now
         clientCommunicationClock.restart();
-        while (clientsUnsent.size() > 0 || toRecieve.size() > 0) {
-          auto successful = sendGameState(clientsUnsent);
-          for (auto s : successful) {
-            clientsUnsent.erase(s);
-            toRecieve[s] = clientSockets[s];
-          }
-          auto succesfulrec = receiveClientInput(toRecieve);
-          for (auto s : succesfulrec) {
-            toRecieve.erase(s.first);
-            newDirs[s.first] = s.second;
-          }
+        sendGameState();
+        while (clientsUnsent.size() > 0 || toReceive.size() > 0) {
+          collectWritten();
+          receiveClientInput();
           spdlog::debug("Server ({}): Clients unsent: {}", frame,
                         clientsUnsent.size());
           spdlog::debug("Server ({}): Clients to recieve: {}", frame,
-                        toRecieve.size());
+                        toReceive.size());
           // Check for clients that have not sent input for a long time
           if (clientCommunicationClock.getElapsedTime().asMilliseconds() >
-              max_client_communication_time) {
-            // Mark all remaining clients for removal
-            for (auto [id, socket] : clientsUnsent) {
-              timedOutPlayers.insert(id);
-            }
-            for (auto [id, socket] : toRecieve) {
-              timedOutPlayers.insert(id);
+              conf.moveTimeout) {
+            // Clients still waiting for their frame keep the rest of it
+            // buffered and miss this move; the high-water mark bounds the lag
+            for (auto id : clientsUnsent) {
+              spdlog::debug("Server ({}): Game state to player {} is still "
+                            "buffered ({} bytes)",
+                            frame, id, clients.at(id).output->size());
             }
             break;
           }
         }
-        for (auto id : timedOutPlayers) {
+        // Clients left in toReceive timed out
+        for (auto id : toReceive) {
           spdlog::info(
               "Server ({}): Client {} has not sent input for a long time",
               frame, id);
-          game->removePlayer(id);
-          clientSockets.erase(id);
-          newDirs.erase(id);
+          dropClient(id);
         }
+        flushSpectators();
         game->movePlayers(newDirs);
+        snapshots.publish(*game);
+#ifdef CYCLES_COUNT_ALLOCATIONS
+        // Counts the game loop's thread only, not the input and output threads
+        spdlog::debug("Server ({}): {} allocations", frame,
+                      allocationCount() - allocations);
+#endif
         frame++;
       }
     }
@@ -242,14 +707,14 @@ int main(int argc, char *argv[]) {
   };
   while (acceptingClients && renderer.isOpen()) {
     renderer.handleEvents({spaceEvent});
-    renderer.renderSplashScreen(game);
+    renderer.renderSplashScreen(*server.getSnapshot(), *game);
   }
   server.setAcceptingClients(false);
   acceptThread.join();
   std::thread serverThread(&GameServer::run, &server);
   while (renderer.isOpen()) {
     renderer.handleEvents();
-    renderer.render(game);
+    renderer.render(*server.getSnapshot(), *game);
   }
   server.stop();
   serverThread.join();
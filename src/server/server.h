@@ -1,15 +1,104 @@
 #pragma once
 #include "api.h"
 #include <SFML/Main.hpp>
-#include <list>
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
 
 namespace cycles_server {
 using cycles::Direction;
 using cycles::Id;
 
+// The cells of a trail behind its head, newest first.
+//
+// Stored in a ring that only reallocates when the tail outgrows it, so that
+// a move (push_front and pop_back) never touches the heap.
+class Tail {
+  std::vector<sf::Vector2i> cells; // size is a power of two, or 0
+  std::size_t first = 0;           // slot of the newest cell
+  std::size_t count = 0;
+
+  const sf::Vector2i &at(std::size_t index) const {
+    return cells[(first + index) & (cells.size() - 1)];
+  }
+
+public:
+  class const_iterator {
+    const Tail *tail = nullptr;
+    std::size_t index = 0;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = sf::Vector2i;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const sf::Vector2i *;
+    using reference = const sf::Vector2i &;
+
+    const_iterator() = default;
+    const_iterator(const Tail *tail, std::size_t index)
+        : tail(tail), index(index) {}
+
+    reference operator*() const { return tail->at(index); }
+    pointer operator->() const { return &tail->at(index); }
+    const_iterator &operator++() {
+      ++index;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      auto copy = *this;
+      ++index;
+      return copy;
+    }
+    bool operator==(const const_iterator &other) const {
+      return index == other.index;
+    }
+  };
+
+  // Makes room for size cells without reallocating
+  void reserve(std::size_t size);
+
+  void push_front(sf::Vector2i cell) {
+    if (count == cells.size()) {
+      reserve(count + 1);
+    }
+    first = (first - 1) & (cells.size() - 1);
+    cells[first] = cell;
+    ++count;
+  }
+
+  void pop_back() { --count; }
+
+  const sf::Vector2i &front() const { return at(0); }
+
+  const sf::Vector2i &back() const { return at(count - 1); }
+
+  std::size_t size() const { return count; }
+
+  bool empty() const { return count == 0; }
+
+  const_iterator begin() const { return {this, 0}; }
+
+  const_iterator end() const { return {this, count}; }
+};
+
+inline void Tail::reserve(std::size_t size) {
+  if (size <= cells.size()) {
+    return;
+  }
+  std::size_t capacity = 64;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  std::vector<sf::Vector2i> grown(capacity);
+  std::copy(begin(), end(), grown.begin());
+  cells.swap(grown);
+  first = 0;
+}
+
 struct Player {
   sf::Vector2i position;
-  std::list<sf::Vector2i> tail;
+  Tail tail;
   sf::Color color;
   std::string name;
   Id id;
@@ -27,6 +116,18 @@ struct Configuration {
   int gameBannerHeight = 100;
   float cellSize = 10;
   bool enablePostProcessing = false;
+  bool enableSharedMemory = true;
+  bool enableUdp = true;
+  int frameInterval = 33; // ms between two frames
+  int moveTimeout = 50;   // ms clients have to answer a frame
+  int maxSpectators = 256;
+  int spectatorInterval = 3; // minimum frames between two frames sent to a spectator
+  int viewportRadius = 0; // cells around its head sent to each client, 0 sends the whole grid
+  bool timestampTrails = false; // cells expire by age instead of through tail lists, for headless games; ids stop at 254
+  bool uncappedTails = false; // tails grow for the whole match
+  bool wrappingBorders = false; // moving off the grid enters it from the opposite side
+  bool longerTailWinsHeadOn = false; // a head-on collision only kills the shorter tails
+  int minSpawnDistance = 2; // cells between two spawns along x or y, at least
   Configuration(std::string configPath);
 };
 } // namespace cycles_server
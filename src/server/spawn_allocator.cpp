@@ -0,0 +1,46 @@
+#include "spawn_allocator.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace cycles_server {
+
+namespace detail {
+// Cells [begin, end) of slot index out of count along an axis of length cells
+void slotExtent(int length, int count, int index, int &begin, int &end) {
+  begin = static_cast<long long>(index) * length / count;
+  end = static_cast<long long>(index + 1) * length / count;
+}
+} // namespace detail
+
+SpawnAllocator::SpawnAllocator(int width, int height, int minDistance,
+                               int capacity)
+    : width(width), height(height) {
+  // Start from the spacing that fits capacity slots in the area, shrink it
+  // until they fit after rounding, but keep it wide enough for minDistance
+  const int narrowest = std::max(1, 2 * minDistance);
+  int spacing = std::max<int>(
+      narrowest,
+      std::sqrt(static_cast<double>(width) * height / std::max(1, capacity)));
+  while (true) {
+    columns = std::max(1, width / spacing);
+    rows = std::max(1, height / spacing);
+    if (spacing == narrowest || columns * rows >= capacity) {
+      break;
+    }
+    --spacing;
+  }
+  slots.resize(static_cast<std::size_t>(columns) * rows);
+  std::iota(slots.begin(), slots.end(), 0);
+}
+
+void SpawnAllocator::middle(int slot, sf::Vector2i &lo,
+                            sf::Vector2i &size) const {
+  int left, right, top, bottom;
+  detail::slotExtent(width, columns, slot % columns, left, right);
+  detail::slotExtent(height, rows, slot / columns, top, bottom);
+  lo = {left + (right - left) / 4, top + (bottom - top) / 4};
+  size = {std::max(1, (right - left) / 2), std::max(1, (bottom - top) / 2)};
+}
+
+} // namespace cycles_server
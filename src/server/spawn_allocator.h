@@ -0,0 +1,66 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <optional>
+#include <random>
+#include <vector>
+
+namespace cycles_server {
+
+// Hands out spawn cells in O(1) each, spread over the grid.
+//
+// The grid is cut into a lattice of square-ish slots, as large as possible
+// while there are at least capacity of them, but never narrower than twice
+// minDistance. Every spawn takes a random slot not taken before and a cell of
+// the middle half of the slot, so two spawns are at least minDistance cells
+// apart along x or y. Once every slot is taken, allocate reports failure.
+class SpawnAllocator {
+  int width;
+  int height;
+  int columns;
+  int rows;
+  std::vector<int> slots; // lattice slots, the first taken ones are used
+  std::size_t taken = 0;
+
+public:
+  SpawnAllocator(int width, int height, int minDistance, int capacity);
+
+  // A free cell in a random slot not taken yet; isFree(cell) tells whether a
+  // cell can be spawned on. A slot whose middle is full is skipped.
+  template <class IsFree>
+  std::optional<sf::Vector2i> allocate(std::mt19937 &rng, IsFree &&isFree) {
+    while (taken < slots.size()) {
+      // Lazy Fisher-Yates shuffle: draw the next slot among the remaining
+      std::uniform_int_distribution<std::size_t> pick(taken, slots.size() - 1);
+      std::swap(slots[taken], slots[pick(rng)]);
+      const auto slot = slots[taken++];
+      sf::Vector2i lo, size;
+      middle(slot, lo, size);
+      // Scan the middle from a random cell, so that a free slot costs one read
+      std::uniform_int_distribution<int> dx(0, size.x - 1), dy(0, size.y - 1);
+      const int startX = dx(rng), startY = dy(rng);
+      for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+          const sf::Vector2i cell(lo.x + (startX + x) % size.x,
+                                  lo.y + (startY + y) % size.y);
+          if (isFree(cell)) {
+            return cell;
+          }
+        }
+      }
+    }
+    return std::nullopt;
+  }
+
+  // Slots not taken yet
+  std::size_t remaining() const { return slots.size() - taken; }
+
+  int getColumns() const { return columns; }
+
+  int getRows() const { return rows; }
+
+private:
+  // The middle half of a slot, where its spawn is picked
+  void middle(int slot, sf::Vector2i &lo, sf::Vector2i &size) const;
+};
+
+} // namespace cycles_server
@@ -0,0 +1,69 @@
+#include "spectator_feed.h"
+#include <algorithm>
+
+namespace cycles_server {
+
+void SpectatorFeed::Subscription::consume(std::size_t bytes) {
+  if (frame == nullptr) {
+    return;
+  }
+  cursor = std::min(cursor + bytes, frame->size());
+  if (cursor == frame->size()) {
+    frame.reset();
+    cursor = 0;
+  }
+}
+
+void SpectatorFeed::publish(int frame, const sf::Packet &packet) {
+  const auto bytes = packet.getDataSize();
+  auto data = std::make_shared<std::vector<std::byte>>(4 + bytes);
+  const auto length = static_cast<sf::Uint32>(bytes);
+  (*data)[0] = std::byte(length >> 24);
+  (*data)[1] = std::byte(length >> 16);
+  (*data)[2] = std::byte(length >> 8);
+  (*data)[3] = std::byte(length);
+  const auto *begin = static_cast<const std::byte *>(packet.getData());
+  std::copy(begin, begin + bytes, data->begin() + 4);
+  latest = std::move(data);
+  latestFrame = frame;
+}
+
+std::span<const std::byte>
+SpectatorFeed::pending(Subscription &subscription) const {
+  if (subscription.frame == nullptr && latest != nullptr &&
+      (subscription.lastFrame < 0 ||
+       latestFrame - subscription.lastFrame >= subscription.interval)) {
+    subscription.frame = latest;
+    subscription.cursor = 0;
+    subscription.lastFrame = latestFrame;
+  }
+  if (subscription.frame == nullptr) {
+    return {};
+  }
+  return {subscription.frame->data() + subscription.cursor,
+          subscription.frame->size() - subscription.cursor};
+}
+
+sf::Socket::Status SpectatorFeed::flush(Subscription &subscription,
+                                        sf::TcpSocket &socket) const {
+  auto bytes = pending(subscription);
+  while (!bytes.empty()) {
+    std::size_t sent = 0;
+    auto status = socket.send(bytes.data(), bytes.size(), sent);
+    subscription.consume(sent);
+    if (status == sf::Socket::NotReady || status == sf::Socket::Partial) {
+      return sf::Socket::Partial;
+    }
+    if (status != sf::Socket::Done) {
+      return status;
+    }
+    bytes = subscription.frame == nullptr
+                ? std::span<const std::byte>()
+                : std::span<const std::byte>(
+                      subscription.frame->data() + subscription.cursor,
+                      subscription.frame->size() - subscription.cursor);
+  }
+  return sf::Socket::Done;
+}
+
+} // namespace cycles_server
@@ -0,0 +1,60 @@
+#pragma once
+#include <SFML/Network.hpp>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace cycles_server {
+
+// Encoded frames shared by every spectator.
+//
+// publish() keeps a single copy of the latest frame, framed the way
+// sf::TcpSocket frames packets. Every subscription points at the frame it is
+// writing and at how much of it went out; once done it moves on to the newest
+// frame at least `interval` frames after the previous one. A slow spectator
+// therefore skips frames instead of queueing them, and nothing is copied per
+// spectator.
+class SpectatorFeed {
+public:
+  class Subscription {
+    friend class SpectatorFeed;
+    std::shared_ptr<const std::vector<std::byte>> frame;
+    std::size_t cursor = 0;
+    int lastFrame = -1;
+    int interval;
+
+  public:
+    explicit Subscription(int interval) : interval(interval < 1 ? 1 : interval) {}
+
+    // Marks bytes of the current frame as written
+    void consume(std::size_t bytes);
+
+    int getInterval() const { return interval; }
+
+    // The frame being written or last written, -1 before the first one
+    int getLastFrame() const { return lastFrame; }
+  };
+
+  // Replaces the latest frame; subscriptions still writing an older frame
+  // keep it alive until they are done
+  void publish(int frame, const sf::Packet &packet);
+
+  // The bytes the subscription still has to write, picking up the latest
+  // frame if the previous one is done and the new one is due
+  std::span<const std::byte> pending(Subscription &subscription) const;
+
+  // Writes as much as the socket takes without blocking. Returns Done once
+  // the current frame is written (or none is due), Partial while bytes are
+  // left, and Disconnected or Error if the socket failed.
+  sf::Socket::Status flush(Subscription &subscription,
+                           sf::TcpSocket &socket) const;
+
+  int getFrame() const { return latestFrame; }
+
+private:
+  std::shared_ptr<const std::vector<std::byte>> latest;
+  int latestFrame = -1;
+};
+
+} // namespace cycles_server
@@ -0,0 +1,106 @@
+#include "tile_index.h"
+#include "protocol.h"
+#include <algorithm>
+
+namespace cycles_server {
+
+using cycles::protocol::gridTileSize;
+
+static_assert(ChunkedGrid::chunkSize % gridTileSize == 0,
+              "Tiles must not straddle chunks");
+
+TileIndex::TileIndex(const ChunkedGrid &grid)
+    : grid(grid),
+      tilesPerRow((grid.getWidth() + gridTileSize - 1) / gridTileSize) {
+  const int tileRows = (grid.getHeight() + gridTileSize - 1) / gridTileSize;
+  tiles.resize(static_cast<std::size_t>(tilesPerRow) * tileRows);
+  versions.assign(tiles.size(), 0);
+}
+
+sf::IntRect TileIndex::getWindow(sf::Vector2i center, int radius) const {
+  const auto floorTile = [](int cell) {
+    return std::max(cell, 0) / gridTileSize * gridTileSize;
+  };
+  const auto ceilTile = [](int cell, int size) {
+    return std::min((cell + gridTileSize - 1) / gridTileSize * gridTileSize,
+                    size);
+  };
+  const int left = floorTile(center.x - radius);
+  const int top = floorTile(center.y - radius);
+  const int right = ceilTile(center.x + radius + 1, grid.getWidth());
+  const int bottom = ceilTile(center.y + radius + 1, grid.getHeight());
+  return {left, top, std::max(right - left, 0), std::max(bottom - top, 0)};
+}
+
+const std::vector<sf::Uint8> &TileIndex::getTile(int tileX, int tileY) {
+  const auto index = static_cast<std::size_t>(tileY) * tilesPerRow + tileX;
+  auto &runs = tiles[index];
+  const int x0 = tileX * gridTileSize;
+  const int y0 = tileY * gridTileSize;
+  // An encoded tile is never empty, and stays valid until its chunk changes
+  const auto version = grid.getChunkVersion(x0 / ChunkedGrid::chunkSize,
+                                            y0 / ChunkedGrid::chunkSize);
+  if (!runs.empty() && versions[index] >= version) {
+    return runs;
+  }
+  versions[index] = grid.getVersion();
+  runs.clear();
+  const int x1 = std::min(x0 + gridTileSize, grid.getWidth());
+  const int y1 = std::min(y0 + gridTileSize, grid.getHeight());
+  // Runs continue from the end of a row to the start of the next one
+  cycles::Id value = grid.get(x0, y0);
+  int count = 0;
+  for (int y = y0; y < y1; ++y) {
+    for (const auto cell : grid.getRow(x0, y, x1 - x0)) {
+      if (cell != value || count == 255) {
+        runs.push_back(value);
+        runs.push_back(static_cast<sf::Uint8>(count));
+        value = cell;
+        count = 0;
+      }
+      ++count;
+    }
+  }
+  runs.push_back(value);
+  runs.push_back(static_cast<sf::Uint8>(count));
+  return runs;
+}
+
+void TileIndex::writeWindow(sf::Packet &packet, const sf::IntRect &window) {
+  packet << static_cast<sf::Int32>(window.left)
+         << static_cast<sf::Int32>(window.top)
+         << static_cast<sf::Int32>(window.width)
+         << static_cast<sf::Int32>(window.height);
+  const int firstX = window.left / gridTileSize;
+  const int firstY = window.top / gridTileSize;
+  const int lastX = (window.left + window.width - 1) / gridTileSize;
+  const int lastY = (window.top + window.height - 1) / gridTileSize;
+  std::size_t encoded = 0;
+  for (int tileY = firstY; tileY <= lastY; ++tileY) {
+    for (int tileX = firstX; tileX <= lastX; ++tileX) {
+      encoded += getTile(tileX, tileY).size();
+    }
+  }
+  const auto cells = static_cast<std::size_t>(window.width) * window.height;
+  if (encoded > cells) {
+    packet << static_cast<sf::Uint8>(cycles::protocol::GridEncoding::raw);
+    const int right = window.left + window.width;
+    for (int y = window.top; y < window.top + window.height; ++y) {
+      for (int x = window.left; x < right;) {
+        const auto row = grid.getRow(x, y, right - x);
+        packet.append(row.data(), row.size());
+        x += static_cast<int>(row.size());
+      }
+    }
+    return;
+  }
+  packet << static_cast<sf::Uint8>(cycles::protocol::GridEncoding::tiles);
+  for (int tileY = firstY; tileY <= lastY; ++tileY) {
+    for (int tileX = firstX; tileX <= lastX; ++tileX) {
+      const auto &runs = getTile(tileX, tileY);
+      packet.append(runs.data(), runs.size());
+    }
+  }
+}
+
+} // namespace cycles_server
@@ -0,0 +1,36 @@
+#pragma once
+#include "chunked_grid.h"
+#include <SFML/Network.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace cycles_server {
+
+// The grid cut in tiles of protocol::gridTileSize cells, each run-length
+// encoded when a viewport first covers it after a change, from which the
+// viewport of every client is assembled. Clients watching the same area
+// share the encoded tiles, and tiles of chunks nobody wrote to are kept
+// from frame to frame.
+class TileIndex {
+  const ChunkedGrid &grid;
+  int tilesPerRow;
+  std::vector<std::vector<sf::Uint8>> tiles;
+  std::vector<std::uint64_t> versions; // grid version each tile was encoded at
+
+public:
+  // The grid must outlive the index
+  explicit TileIndex(const ChunkedGrid &grid);
+
+  // The smallest window made of whole tiles (cut at the edges of the grid)
+  // holding every cell within radius of a position
+  sf::IntRect getWindow(sf::Vector2i center, int radius) const;
+
+  // Appends the grid section of a frame covering a window from getWindow.
+  // Falls back to raw cells when the runs would take more room.
+  void writeWindow(sf::Packet &packet, const sf::IntRect &window);
+
+  // The run-length encoding of a tile for the current grid
+  const std::vector<sf::Uint8> &getTile(int tileX, int tileY);
+};
+
+} // namespace cycles_server
@@ -0,0 +1,246 @@
+#include "shared_memory.h"
+#include <atomic>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CYCLES_HAS_SHARED_MEMORY 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cycles {
+
+namespace detail {
+constexpr sf::Uint32 sharedMemoryMagic = 0x43594331; // "CYC1"
+constexpr int frameSlotCount = 4;
+constexpr std::size_t roundUp(std::size_t bytes) { return (bytes + 63) & ~63; }
+} // namespace detail
+
+struct SharedFrameBuffer::Header {
+  std::atomic<sf::Uint32> magic;
+  sf::Uint32 frameCapacity;
+  sf::Int32 clientSlots;
+  std::atomic<sf::Int32> latestFrame;
+};
+
+struct alignas(64) SharedFrameBuffer::MoveSlot {
+  std::atomic<sf::Uint64> move; ///< (frame + 1) << 8 | direction, 0 if empty
+  std::atomic<sf::Uint32> closed;
+};
+
+struct alignas(64) SharedFrameBuffer::FrameSlot {
+  std::atomic<sf::Uint32> sequence; ///< Odd while the slot is being written
+  std::atomic<sf::Uint32> size;
+  std::atomic<sf::Int32> frame;
+  std::byte *data() { return reinterpret_cast<std::byte *>(this + 1); }
+};
+
+static_assert(std::atomic<sf::Uint64>::is_always_lock_free &&
+                  std::atomic<sf::Uint32>::is_always_lock_free,
+              "Shared memory atomics must be address free");
+
+SharedFrameBuffer::FrameSlot &SharedFrameBuffer::frameSlot(int index) const {
+  const auto stride =
+      detail::roundUp(sizeof(FrameSlot) + header->frameCapacity);
+  return *reinterpret_cast<FrameSlot *>(frameSlots + index * stride);
+}
+
+bool SharedFrameBuffer::map(int fd, std::size_t bytes) {
+#ifdef CYCLES_HAS_SHARED_MEMORY
+  memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    memory = nullptr;
+    return false;
+  }
+  size = bytes;
+  header = static_cast<Header *>(memory);
+  return true;
+#else
+  (void)fd;
+  (void)bytes;
+  return false;
+#endif
+}
+
+std::unique_ptr<SharedFrameBuffer>
+SharedFrameBuffer::create(const std::string &name, std::size_t frameCapacity,
+                          int clientSlots) {
+#ifdef CYCLES_HAS_SHARED_MEMORY
+  const auto bytes =
+      detail::roundUp(sizeof(Header)) + clientSlots * sizeof(MoveSlot) +
+      detail::frameSlotCount * detail::roundUp(sizeof(FrameSlot) + frameCapacity);
+  // Remove a segment left behind by a server that did not exit cleanly
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    spdlog::warn("Failed to create shared memory segment {}", name);
+    return nullptr;
+  }
+  if (ftruncate(fd, bytes) != 0) {
+    ::close(fd);
+    shm_unlink(name.c_str());
+    spdlog::warn("Failed to size shared memory segment {}", name);
+    return nullptr;
+  }
+  std::unique_ptr<SharedFrameBuffer> buffer(new SharedFrameBuffer());
+  buffer->name = name;
+  buffer->owner = true;
+  if (!buffer->map(fd, bytes)) {
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  // The segment is zero filled, so every atomic starts at 0
+  auto *header = buffer->header;
+  header->frameCapacity = frameCapacity;
+  header->clientSlots = clientSlots;
+  header->latestFrame.store(-1, std::memory_order_relaxed);
+  buffer->moveSlots = reinterpret_cast<MoveSlot *>(
+      static_cast<std::byte *>(buffer->memory) +
+      detail::roundUp(sizeof(Header)));
+  buffer->frameSlots =
+      reinterpret_cast<std::byte *>(buffer->moveSlots + clientSlots);
+  // Clients refuse to use the segment until the magic is set
+  header->magic.store(detail::sharedMemoryMagic, std::memory_order_release);
+  return buffer;
+#else
+  (void)name;
+  (void)frameCapacity;
+  (void)clientSlots;
+  return nullptr;
+#endif
+}
+
+std::unique_ptr<SharedFrameBuffer>
+SharedFrameBuffer::open(const std::string &name) {
+#ifdef CYCLES_HAS_SHARED_MEMORY
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<std::size_t>(info.st_size) < sizeof(Header)) {
+    ::close(fd);
+    return nullptr;
+  }
+  std::unique_ptr<SharedFrameBuffer> buffer(new SharedFrameBuffer());
+  buffer->name = name;
+  if (!buffer->map(fd, info.st_size)) {
+    return nullptr;
+  }
+  auto *header = buffer->header;
+  if (header->magic.load(std::memory_order_acquire) !=
+      detail::sharedMemoryMagic) {
+    spdlog::debug("Shared memory segment {} is not ready", name);
+    return nullptr;
+  }
+  buffer->moveSlots = reinterpret_cast<MoveSlot *>(
+      static_cast<std::byte *>(buffer->memory) +
+      detail::roundUp(sizeof(Header)));
+  buffer->frameSlots =
+      reinterpret_cast<std::byte *>(buffer->moveSlots + header->clientSlots);
+  const auto expected =
+      detail::roundUp(sizeof(Header)) + header->clientSlots * sizeof(MoveSlot) +
+      detail::frameSlotCount *
+          detail::roundUp(sizeof(FrameSlot) + header->frameCapacity);
+  if (buffer->size < expected) {
+    spdlog::warn("Shared memory segment {} is truncated", name);
+    return nullptr;
+  }
+  return buffer;
+#else
+  (void)name;
+  return nullptr;
+#endif
+}
+
+SharedFrameBuffer::~SharedFrameBuffer() {
+#ifdef CYCLES_HAS_SHARED_MEMORY
+  if (memory != nullptr) {
+    munmap(memory, size);
+  }
+  if (owner) {
+    shm_unlink(name.c_str());
+  }
+#endif
+}
+
+bool SharedFrameBuffer::publishFrame(int frame, const void *data,
+                                     std::size_t bytes) {
+  if (bytes > header->frameCapacity) {
+    return false;
+  }
+  auto &slot = frameSlot(frame % detail::frameSlotCount);
+  const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(slot.data(), data, bytes);
+  slot.size.store(bytes, std::memory_order_relaxed);
+  slot.frame.store(frame, std::memory_order_relaxed);
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+  header->latestFrame.store(frame, std::memory_order_release);
+  return true;
+}
+
+bool SharedFrameBuffer::readFrame(int afterFrame, sf::Packet &packet,
+                                  int &frame) const {
+  const auto latest = header->latestFrame.load(std::memory_order_acquire);
+  if (latest <= afterFrame) {
+    return false;
+  }
+  auto &slot = frameSlot(latest % detail::frameSlotCount);
+  while (true) {
+    const auto before = slot.sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      continue;
+    }
+    const auto bytes = slot.size.load(std::memory_order_relaxed);
+    frame = slot.frame.load(std::memory_order_relaxed);
+    if (bytes > header->frameCapacity) {
+      continue;
+    }
+    packet.clear();
+    packet.append(slot.data(), bytes);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // A changed sequence means the writer lapped us while copying
+    if (slot.sequence.load(std::memory_order_relaxed) == before) {
+      return frame > afterFrame;
+    }
+  }
+}
+
+void SharedFrameBuffer::postMove(int slot, int frame, Direction direction) {
+  const sf::Uint64 word = (static_cast<sf::Uint64>(frame + 1) << 8) |
+                          static_cast<sf::Uint64>(getDirectionValue(direction));
+  moveSlots[slot].move.store(word, std::memory_order_release);
+}
+
+bool SharedFrameBuffer::takeMove(int slot, int frame, Direction &direction) {
+  const auto word = moveSlots[slot].move.load(std::memory_order_acquire);
+  if ((word >> 8) != static_cast<sf::Uint64>(frame + 1) || (word & 0xFF) > 3) {
+    return false;
+  }
+  direction = getDirectionFromValue(word & 0xFF);
+  return true;
+}
+
+void SharedFrameBuffer::closeSlot(int slot) {
+  moveSlots[slot].closed.store(1, std::memory_order_release);
+}
+
+void SharedFrameBuffer::openSlot(int slot) {
+  moveSlots[slot].move.store(0, std::memory_order_relaxed);
+  moveSlots[slot].closed.store(0, std::memory_order_release);
+}
+
+bool SharedFrameBuffer::isSlotClosed(int slot) const {
+  return moveSlots[slot].closed.load(std::memory_order_acquire) != 0;
+}
+
+int SharedFrameBuffer::getClientSlots() const { return header->clientSlots; }
+
+} // namespace cycles
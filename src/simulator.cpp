@@ -0,0 +1,155 @@
+#include "simulator.h"
+#include "rules.h"
+#include <bit>
+
+namespace cycles {
+
+Simulator::Simulator(const GameState &state, int horizon)
+    : width(state.getArenaSize().x), stride(width + 2),
+      frame(state.frameNumber), horizon(horizon) {
+  const int height = state.getArenaSize().y;
+  // A viewport only holds part of the arena, the rest is rebuilt from the
+  // players (outside of the window every occupied cell is a head or a tail)
+  std::vector<Id> arena;
+  const Id *cells = state.grid.data();
+  if (state.gridWidth != width || state.gridHeight != height) {
+    state.getArenaGrid(arena);
+    cells = arena.data();
+  }
+  grid.assign(static_cast<std::size_t>(stride) * (height + 2), wall);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      grid[toCell({x, y})] = cells[y * width + x];
+    }
+  }
+  offsets[getDirectionValue(Direction::north)] = -stride;
+  offsets[getDirectionValue(Direction::east)] = 1;
+  offsets[getDirectionValue(Direction::south)] = stride;
+  offsets[getDirectionValue(Direction::west)] = -1;
+  // Tails never grow past the maximum length at the end of the horizon
+  std::size_t longest = rules::maxTailLength(frame + horizon) + 2;
+  for (const auto &player : state.players) {
+    longest = std::max(longest, player.tail.size() + horizon + 1);
+  }
+  tailCapacity = static_cast<int>(std::bit_ceil(longest));
+  const int players = static_cast<int>(state.players.size());
+  agents.resize(players);
+  tails.resize(static_cast<std::size_t>(players) * tailCapacity);
+  for (int p = 0; p < players; ++p) {
+    const auto &player = state.players[p];
+    auto &agent = agents[p];
+    agent.head = toCell(player.position);
+    agent.id = player.id;
+    agent.tailLength = static_cast<int>(player.tail.size());
+    for (int i = 0; i < agent.tailLength; ++i) {
+      tailCell(p, i) = toCell(player.tail[i]);
+    }
+  }
+  aliveCount = players;
+  history.resize(static_cast<std::size_t>(horizon) * players);
+  claims.resize(grid.size());
+  claimStamps.assign(grid.size(), 0);
+}
+
+std::uint8_t Simulator::getLegalMoves(int player) const {
+  const auto head = agents[player].head;
+  std::uint8_t moves = 0;
+  for (int d = 0; d < 4; ++d) {
+    moves |= static_cast<std::uint8_t>(grid[head + offsets[d]] == 0) << d;
+  }
+  return moves;
+}
+
+void Simulator::paintBody(int player, std::uint8_t value) {
+  const auto &agent = agents[player];
+  grid[agent.head] = value;
+  for (int i = 0; i < agent.tailLength; ++i) {
+    grid[tailCell(player, i)] = value;
+  }
+}
+
+void Simulator::make(std::span<const Direction> directions) {
+  const int players = getPlayerCount();
+  auto *changes = history.data() + static_cast<std::size_t>(depth) * players;
+  const int maxTail = rules::maxTailLength(frame);
+  // Collisions are checked against the grid before anyone moves
+  ++stamp;
+  for (int p = 0; p < players; ++p) {
+    auto &change = changes[p];
+    change = {};
+    if (!agents[p].alive) {
+      change.target = -1;
+      continue;
+    }
+    change.target =
+        agents[p].head + offsets[getDirectionValue(directions[p])];
+    if (grid[change.target] != 0) {
+      change.died = true;
+    }
+    // Players moving to the same cell both die
+    if (claimStamps[change.target] == stamp) {
+      change.died = true;
+      changes[claims[change.target]].died = true;
+    } else {
+      claimStamps[change.target] = stamp;
+      claims[change.target] = p;
+    }
+  }
+  for (int p = 0; p < players; ++p) {
+    if (changes[p].died) {
+      paintBody(p, 0);
+      agents[p].alive = false;
+      --aliveCount;
+    }
+  }
+  for (int p = 0; p < players; ++p) {
+    auto &change = changes[p];
+    if (change.target < 0 || change.died) {
+      continue;
+    }
+    auto &agent = agents[p];
+    grid[change.target] = agent.id;
+    if (agent.tailLength > maxTail) {
+      change.popped = tailCell(p, --agent.tailLength);
+      grid[change.popped] = 0;
+    }
+    agent.tailStart = (agent.tailStart - 1) & (tailCapacity - 1);
+    ++agent.tailLength;
+    tailCell(p, 0) = agent.head;
+    agent.head = change.target;
+  }
+  ++depth;
+  ++frame;
+}
+
+void Simulator::unmake() {
+  --depth;
+  --frame;
+  const int players = getPlayerCount();
+  const auto *changes =
+      history.data() + static_cast<std::size_t>(depth) * players;
+  for (int p = players - 1; p >= 0; --p) {
+    const auto &change = changes[p];
+    if (change.target < 0 || change.died) {
+      continue;
+    }
+    auto &agent = agents[p];
+    grid[agent.head] = 0;
+    agent.head = tailCell(p, 0);
+    agent.tailStart = (agent.tailStart + 1) & (tailCapacity - 1);
+    --agent.tailLength;
+    if (change.popped >= 0) {
+      tailCell(p, agent.tailLength++) = change.popped;
+      grid[change.popped] = agent.id;
+    }
+  }
+  for (int p = 0; p < players; ++p) {
+    if (changes[p].died) {
+      agents[p].alive = true;
+      ++aliveCount;
+      paintBody(p, agents[p].id);
+    }
+  }
+}
+
+} // namespace cycles
@@ -0,0 +1,324 @@
+#include "territory.h"
+#include <algorithm>
+#include <bit>
+
+namespace cycles {
+
+namespace detail {
+// One BFS step: out = (in and its four neighbors) & mask on the rows next
+// to the frontier. Returns the rows of out holding set bits; out must be
+// clear outside of the rows it writes. The padding rows are never set, so
+// every neighbor access stays in bounds without branches. Only the rows next
+// to the frontier are touched, so a step costs in proportion to the span of
+// the frontier rather than to the size of the board.
+Rows grow(const std::uint64_t *in, Rows rows, const std::uint64_t *mask,
+          std::uint64_t *out, std::size_t stride, int height) {
+  const int first = std::max(rows.first - 1, 1);
+  const int last = std::min(rows.last + 1, height);
+  Rows grown{last + 1, first - 1};
+  for (int row = first; row <= last; ++row) {
+    std::uint64_t any = 0;
+    const auto end = (row + 1) * stride;
+    for (auto i = row * stride; i < end; ++i) {
+      const auto word = in[i];
+      const auto east = (word << 1) | (in[i - 1] >> 63);
+      const auto west = (word >> 1) | (in[i + 1] << 63);
+      out[i] = (word | east | west | in[i - stride] | in[i + stride]) & mask[i];
+      any |= out[i];
+    }
+    if (any != 0) {
+      grown.first = std::min(grown.first, row);
+      grown.last = row;
+    }
+  }
+  return grown;
+}
+
+// Spreads the cells of one padded row to the ends of the free runs they
+// touch, with a Kogge-Stone fill towards both ends of the row. Takes
+// log2(row bits) passes instead of one pass per cell of the longest run.
+void fillRow(std::uint64_t *row, const std::uint64_t *free,
+             std::uint64_t *runs, std::size_t stride) {
+  const auto bits = stride * 64;
+  // Towards higher bits; runs[i] holds the cells whose k lower cells are free
+  std::copy_n(free, stride, runs);
+  for (std::size_t k = 1; k < bits; k *= 2) {
+    const auto q = k / 64;
+    const auto r = k % 64;
+    // Descending, so that lower words still hold the values of this pass
+    for (std::size_t i = stride; i-- > 0;) {
+      std::uint64_t cells = 0, open = 0;
+      if (r != 0) {
+        cells = (row[i] << r) | (i > 0 ? row[i - 1] >> (64 - r) : 0);
+        open = (runs[i] << r) | (i > 0 ? runs[i - 1] >> (64 - r) : 0);
+      } else if (i >= q) {
+        cells = row[i - q];
+        open = runs[i - q];
+      }
+      row[i] |= cells & runs[i];
+      runs[i] &= open;
+    }
+  }
+  // Towards lower bits, mirrored
+  std::copy_n(free, stride, runs);
+  for (std::size_t k = 1; k < bits; k *= 2) {
+    const auto q = k / 64;
+    const auto r = k % 64;
+    for (std::size_t i = 0; i < stride; ++i) {
+      std::uint64_t cells = 0, open = 0;
+      if (r != 0) {
+        cells = (row[i] >> r) | (i + 1 < stride ? row[i + 1] << (64 - r) : 0);
+        open = (runs[i] >> r) | (i + 1 < stride ? runs[i + 1] << (64 - r) : 0);
+      } else if (i + q < stride) {
+        cells = row[i + q];
+        open = runs[i + q];
+      }
+      row[i] |= cells & runs[i];
+      runs[i] &= open;
+    }
+  }
+}
+
+// Clears the rows of a board grown from a frontier, see grow
+void clear(std::uint64_t *board, Rows rows, std::size_t stride) {
+  if (!rows.empty()) {
+    const int first = std::max(rows.first - 1, 0);
+    std::fill(board + first * stride, board + (rows.last + 2) * stride, 0);
+  }
+}
+} // namespace detail
+
+std::size_t TerritoryEvaluator::bitIndex(sf::Vector2i position) const {
+  const auto cell = position - state->windowOffset;
+  return (cell.y + 1) * stride * 64 + cell.x + 1;
+}
+
+void TerritoryEvaluator::reset(const GameState &state) {
+  this->state = &state;
+  const auto &occupancy = state.getOccupancy();
+  const auto words = occupancy.getWords();
+  stride = occupancy.getStride();
+  height = occupancy.getHeight();
+  free.resize(words.size());
+  const auto width = static_cast<std::size_t>(occupancy.getWidth());
+  // Padding bits are occupied, but so are the unused bits at the end of a
+  // row, which occupancy leaves clear
+  for (std::size_t row = 0; row * stride < words.size(); ++row) {
+    for (std::size_t word = 0; word < stride; ++word) {
+      const auto i = row * stride + word;
+      const auto first = word * 64;
+      std::uint64_t cells = ~std::uint64_t(0);
+      if (first + 64 > width + 1) {
+        const auto used = width + 1 > first ? width + 1 - first : 0;
+        cells = used == 0 ? 0 : ~std::uint64_t(0) >> (64 - used);
+      }
+      free[i] = ~words[i] & cells;
+    }
+  }
+  mask.resize(free.size());
+  reached.assign(free.size(), 0);
+  next.assign(free.size(), 0);
+}
+
+detail::Rows TerritoryEvaluator::seed(std::uint64_t *board,
+                                      sf::Vector2i position) {
+  // Heads outside the window (in viewport mode) do not take part
+  if (!state->isInsideGrid(position)) {
+    return {1, 0};
+  }
+  const auto bit = bitIndex(position);
+  board[bit / 64] |= std::uint64_t(1) << (bit % 64);
+  mask[bit / 64] &= ~(std::uint64_t(1) << (bit % 64));
+  const auto row = position.y - state->windowOffset.y + 1;
+  return {row, row};
+}
+
+template <class Visit>
+void TerritoryEvaluator::search(std::span<const sf::Vector2i> sources,
+                                Visit &&visit) {
+  mask = free;
+  detail::Rows rows{height + 1, 0};
+  for (auto source : sources) {
+    const auto seeded = seed(reached.data(), source);
+    rows = {std::min(rows.first, seeded.first),
+            std::max(rows.last, seeded.last)};
+  }
+  detail::Rows nextRows{1, 0};
+  for (int step = 1; !rows.empty(); ++step) {
+    detail::clear(next.data(), nextRows, stride);
+    nextRows = detail::grow(reached.data(), rows, mask.data(), next.data(),
+                            stride, height);
+    // Cells leave the mask once reached, so next only holds the new layer
+    for (int row = nextRows.first; row <= nextRows.last; ++row) {
+      for (auto i = row * stride; i < (row + 1) * stride; ++i) {
+        mask[i] &= ~next[i];
+        visit(step, i, next[i]);
+      }
+    }
+    std::swap(reached, next);
+    std::swap(rows, nextRows);
+  }
+  detail::clear(reached.data(), rows, stride);
+  detail::clear(next.data(), nextRows, stride);
+}
+
+int TerritoryEvaluator::floodFill(sf::Vector2i start) {
+  // No layers are needed here, so instead of one BFS step per pass, every
+  // row is filled along its free runs as soon as it gains cells, while
+  // sweeping down and then up the board until nothing changes
+  if (!state->isInsideGrid(start)) {
+    return 0;
+  }
+  const auto bit = bitIndex(start);
+  const auto startWord = bit / 64;
+  const auto startBit = std::uint64_t(1) << (bit % 64);
+  std::fill(reached.begin(), reached.end(), 0);
+  const auto startRow = start.y - state->windowOffset.y + 1;
+  const detail::Rows rows{startRow, startRow};
+  reached[startWord] = startBit;
+  detail::grow(reached.data(), rows, free.data(), next.data(), stride, height);
+  reached[startWord] = 0;
+  std::swap(reached, next);
+  detail::clear(next.data(), rows, stride);
+  runs.resize(stride);
+  auto sweep = [this](int row, int from) {
+    auto *cells = reached.data() + row * stride;
+    const auto *source = reached.data() + from * stride;
+    const auto *open = free.data() + row * stride;
+    std::uint64_t gained = 0;
+    for (std::size_t i = 0; i < stride; ++i) {
+      const auto before = cells[i];
+      cells[i] |= source[i] & open[i];
+      gained |= cells[i] ^ before;
+    }
+    if (gained != 0) {
+      detail::fillRow(cells, open, runs.data(), stride);
+    }
+    return gained != 0;
+  };
+  for (int row = rows.first - 1; row <= rows.last + 1; ++row) {
+    if (row >= 1 && row <= height) {
+      detail::fillRow(reached.data() + row * stride,
+                      free.data() + row * stride, runs.data(), stride);
+    }
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int row = 2; row <= height; ++row) {
+      changed = sweep(row, row - 1) || changed;
+    }
+    for (int row = height - 1; row >= 1; --row) {
+      changed = sweep(row, row + 1) || changed;
+    }
+  }
+  int cells = 0;
+  for (auto word : reached) {
+    cells += std::popcount(word);
+  }
+  // A free start cell is part of its own region but is not counted
+  if (free[startWord] & startBit) {
+    cells--;
+  }
+  std::fill(reached.begin(), reached.end(), 0);
+  return cells;
+}
+
+const std::vector<std::uint16_t> &
+TerritoryEvaluator::distances(std::span<const sf::Vector2i> sources) {
+  const auto width = state->gridWidth;
+  distanceMap.assign(static_cast<std::size_t>(width) * height, unreachable);
+  for (auto source : sources) {
+    if (state->isInsideGrid(source)) {
+      const auto cell = source - state->windowOffset;
+      distanceMap[cell.y * width + cell.x] = 0;
+    }
+  }
+  const auto rowBits = stride * 64;
+  search(sources, [&](int step, std::size_t i, std::uint64_t word) {
+    const auto distance =
+        static_cast<std::uint16_t>(std::min<int>(step, unreachable - 1));
+    while (word != 0) {
+      const auto bit = i * 64 + std::countr_zero(word);
+      distanceMap[(bit / rowBits - 1) * width + bit % rowBits - 1] = distance;
+      word &= word - 1;
+    }
+  });
+  return distanceMap;
+}
+
+const std::vector<int> &TerritoryEvaluator::voronoi() {
+  const auto players = state->players.size();
+  const auto words = free.size();
+  territory.assign(players, 0);
+  frontiers.assign(players * words, 0);
+  frontierRows.resize(players);
+  grown.assign(players * words, 0);
+  seenOnce.assign(words, 0);
+  seenTwice.assign(words, 0);
+  mask = free;
+  for (std::size_t p = 0; p < players; ++p) {
+    frontierRows[p] =
+        seed(frontiers.data() + p * words, state->players[p].position);
+  }
+  std::vector<detail::Rows> &grownRows = scratchRows;
+  grownRows.assign(players, {1, 0});
+  bool growing = players > 0;
+  while (growing) {
+    // Rows touched by any player in this step
+    detail::Rows touched{height + 1, 0};
+    for (std::size_t p = 0; p < players; ++p) {
+      if (frontierRows[p].empty()) {
+        continue;
+      }
+      auto *out = grown.data() + p * words;
+      detail::clear(out, grownRows[p], stride);
+      grownRows[p] = detail::grow(frontiers.data() + p * words,
+                                  frontierRows[p], mask.data(), out, stride,
+                                  height);
+      for (int row = grownRows[p].first; row <= grownRows[p].last; ++row) {
+        for (auto i = row * stride; i < (row + 1) * stride; ++i) {
+          seenTwice[i] |= seenOnce[i] & out[i];
+          seenOnce[i] |= out[i];
+        }
+      }
+      touched = {std::min(touched.first, grownRows[p].first),
+                 std::max(touched.last, grownRows[p].last)};
+    }
+    // Cells reached by several players in the same step belong to nobody
+    // and do not grow further
+    growing = false;
+    for (std::size_t p = 0; p < players; ++p) {
+      auto *frontier = frontiers.data() + p * words;
+      const auto *out = grown.data() + p * words;
+      detail::clear(frontier, frontierRows[p], stride);
+      frontierRows[p] = {1, 0};
+      if (grownRows[p].empty()) {
+        continue;
+      }
+      int owned = 0;
+      for (int row = grownRows[p].first; row <= grownRows[p].last; ++row) {
+        for (auto i = row * stride; i < (row + 1) * stride; ++i) {
+          frontier[i] = out[i] & ~seenTwice[i];
+          owned += std::popcount(frontier[i]);
+        }
+      }
+      if (owned > 0) {
+        frontierRows[p] = grownRows[p];
+        territory[p] += owned;
+        growing = true;
+      }
+    }
+    if (!touched.empty()) {
+      for (auto i = touched.first * stride; i < (touched.last + 1) * stride;
+           ++i) {
+        mask[i] &= ~seenOnce[i];
+        seenOnce[i] = 0;
+        seenTwice[i] = 0;
+      }
+    }
+  }
+  return territory;
+}
+
+} // namespace cycles
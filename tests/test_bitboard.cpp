@@ -0,0 +1,45 @@
+//GTest tests for the occupancy bitboard
+#include"bitboard.h"
+#include"gtest/gtest.h"
+using namespace cycles;
+
+TEST(BitboardTest, MatchesGrid) {
+  // Wide enough for padded rows to span two words
+  const int width = 70, height = 5;
+  std::vector<std::uint8_t> grid(width * height, 0);
+  grid[2 * width + 63] = 1;
+  grid[4 * width + 69] = 7;
+  OccupancyBitboard board;
+  board.build(grid, width, height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      EXPECT_EQ(board.isOccupied({x, y}), grid[y * width + x] != 0) << x << "," << y;
+    }
+  }
+}
+
+TEST(BitboardTest, OutsideIsOccupied) {
+  std::vector<std::uint8_t> grid(64 * 3, 0);
+  OccupancyBitboard board;
+  board.build(grid, 64, 3);
+  for (int x = -1; x <= 64; x++) {
+    EXPECT_TRUE(board.isOccupied({x, -1}));
+    EXPECT_TRUE(board.isOccupied({x, 3}));
+  }
+  for (int y = 0; y < 3; y++) {
+    EXPECT_TRUE(board.isOccupied({-1, y}));
+    EXPECT_TRUE(board.isOccupied({64, y}));
+  }
+}
+
+TEST(BitboardTest, FreeNeighbors) {
+  std::vector<std::uint8_t> grid(4 * 4, 0);
+  grid[1 * 4 + 2] = 1; // east of (1, 1)
+  OccupancyBitboard board;
+  board.build(grid, 4, 4);
+  // north, south and west are free
+  EXPECT_EQ(board.getFreeNeighbors({1, 1}), 0b1101);
+  // The corner only has east and south
+  EXPECT_EQ(board.getFreeNeighbors({0, 0}), 0b0110);
+  EXPECT_EQ(board.getFreeNeighbors({3, 3}), 0b1001);
+}
@@ -0,0 +1,76 @@
+//GTest tests for the coroutine bot loop
+#include"bot_loop.h"
+#include"server/local_match.h"
+#include"gtest/gtest.h"
+#include"test_config.h"
+#include<thread>
+using namespace cycles;
+using cycles_server::Game;
+using cycles_server::LocalMatch;
+
+// Thinks for a few yields on every state, then moves in the first free
+// direction starting from a preferred one
+BotTask play(BotLoop &loop, std::string name, Direction preferred,
+             int &states, int &sent) {
+  while (auto state = co_await loop.nextState()) {
+    states++;
+    for (int i = 0; i < 3; i++) {
+      co_await loop.yield();
+    }
+    sf::Vector2i position;
+    for (const auto &player : state->players) {
+      if (player.name == name) {
+        position = player.position;
+      }
+    }
+    auto direction = preferred;
+    for (int i = 0; i < 4; i++) {
+      auto candidate = getDirectionFromValue((int(preferred) + i) % 4);
+      auto next = position + getDirectionVector(candidate);
+      if (state->isInsideGrid(next) && state->isCellEmpty(next)) {
+        direction = candidate;
+        break;
+      }
+    }
+    if (co_await loop.move(direction) == sf::Socket::Done) {
+      sent++;
+    }
+  }
+}
+
+void runBot(LocalConnection connection, std::string name, Direction preferred,
+            int &states, int &sent) {
+  BotLoop loop(connection);
+  loop.run(play(loop, name, preferred, states, sent));
+}
+
+TEST(BotLoopTest, PlaysOverALocalConnection) {
+  auto game = std::make_shared<Game>(testConfig(20, 20), 7);
+  LocalMatch match(game);
+  int states0 = 0, sent0 = 0, states1 = 0, sent1 = 0;
+  std::thread bot0(runBot, match.connect("bot0"), "bot0", Direction::north,
+                   std::ref(states0), std::ref(sent0));
+  std::thread bot1(runBot, match.connect("bot1"), "bot1", Direction::south,
+                   std::ref(states1), std::ref(sent1));
+  // The run closes the channels, so the coroutines see the end of the match
+  match.run(20);
+  bot0.join();
+  bot1.join();
+  EXPECT_GT(match.getFrame(), 1);
+  EXPECT_GT(sent0, 1);
+  EXPECT_GT(sent1, 1);
+  // Every move answers a state received
+  EXPECT_LE(sent0, states0);
+  EXPECT_LE(sent1, states1);
+}
+
+TEST(BotLoopTest, EndsWhenTheChannelIsClosed) {
+  auto game = std::make_shared<Game>(testConfig(20, 20), 7);
+  auto connection = LocalMatch(game).connect("alone");
+  // The match is gone, so the first await returns no state
+  int states = 0, sent = 0;
+  BotLoop loop(connection);
+  loop.run(play(loop, "alone", Direction::north, states, sent));
+  EXPECT_EQ(states, 0);
+  EXPECT_EQ(sent, 0);
+}
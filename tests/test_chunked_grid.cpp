@@ -0,0 +1,70 @@
+//GTest tests for the chunked grid of the server
+#include"server/chunked_grid.h"
+#include"gtest/gtest.h"
+#include<random>
+using cycles::Id;
+using cycles_server::ChunkedGrid;
+
+TEST(ChunkedGridTest, StoresTheGrid) {
+  // A size that is not a multiple of the chunk size
+  const int width = 150, height = 70;
+  std::mt19937 rng(1);
+  std::vector<Id> cells(width * height, 0);
+  ChunkedGrid grid(width, height);
+  for (int i = 0; i < 2000; i++) {
+    int x = rng() % width, y = rng() % height;
+    Id value = rng() % 4;
+    cells[y * width + x] = value;
+    grid.set(x, y, value);
+  }
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      ASSERT_EQ(grid.get(x, y), cells[y * width + x]);
+    }
+  }
+  std::vector<Id> copy;
+  grid.copyTo(copy);
+  EXPECT_EQ(copy, cells);
+}
+
+TEST(ChunkedGridTest, AllocatesOnlyOccupiedChunks) {
+  ChunkedGrid grid(10000, 10000);
+  EXPECT_EQ(grid.getAllocatedChunks(), 0);
+  // Writing zeros to an empty chunk does not allocate it
+  grid.set(5, 5, 0);
+  EXPECT_EQ(grid.getAllocatedChunks(), 0);
+  grid.set(5, 5, 1);
+  grid.set(6, 5, 1);
+  grid.set(9999, 9999, 2);
+  EXPECT_EQ(grid.getAllocatedChunks(), 2);
+  grid.set(5, 5, 0);
+  EXPECT_EQ(grid.getAllocatedChunks(), 2);
+  grid.set(6, 5, 0);
+  EXPECT_EQ(grid.getAllocatedChunks(), 1);
+  EXPECT_EQ(grid.get(6, 5), 0);
+  EXPECT_EQ(grid.getRow(0, 5, 100).size(), ChunkedGrid::chunkSize);
+}
+
+TEST(ChunkedGridTest, TracksChangedChunks) {
+  ChunkedGrid grid(256, 256);
+  grid.set(10, 10, 1);
+  const auto seen = grid.getVersion();
+  std::vector<std::pair<int, int>> changed;
+  auto collect = [&](int chunkX, int chunkY, const ChunkedGrid::Chunk *chunk) {
+    changed.push_back({chunkX, chunkY});
+    if (chunkX == 0) {
+      EXPECT_EQ(chunk, nullptr);
+    } else {
+      ASSERT_NE(chunk, nullptr);
+      EXPECT_EQ(chunk->cells[70 % 64 * 64 + 130 % 64], 3);
+    }
+  };
+  // Rewriting a cell with its value is not a change
+  grid.set(10, 10, 1);
+  grid.forEachChangedChunk(seen, collect);
+  EXPECT_TRUE(changed.empty());
+  grid.set(130, 70, 3);
+  grid.set(10, 10, 0);
+  grid.forEachChangedChunk(seen, collect);
+  EXPECT_EQ(changed, (std::vector<std::pair<int, int>>{{0, 0}, {2, 1}}));
+}
@@ -0,0 +1,11 @@
+//Configuration shared by the tests, built without a file
+#pragma once
+#include"server/server.h"
+
+// The default configuration on a grid of the given size
+inline cycles_server::Configuration testConfig(int gridWidth, int gridHeight) {
+  cycles_server::Configuration conf("");
+  conf.gridWidth = gridWidth;
+  conf.gridHeight = gridHeight;
+  return conf;
+}
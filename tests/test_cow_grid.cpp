@@ -0,0 +1,78 @@
+//GTest tests for the copy-on-write grid
+#include"cow_grid.h"
+#include"gtest/gtest.h"
+#include<random>
+#include<thread>
+using cycles::CowGrid;
+using cycles::Id;
+
+std::vector<Id> randomGrid(int width, int height, unsigned int seed) {
+  std::mt19937 rng(seed);
+  std::vector<Id> grid(width * height);
+  for (auto &cell : grid) {
+    cell = rng() % 4;
+  }
+  return grid;
+}
+
+TEST(CowGridTest, StoresTheGrid) {
+  // A size that is not a multiple of the chunk size
+  const int width = 75, height = 40;
+  auto grid = randomGrid(width, height, 1);
+  CowGrid cow(grid, width, height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      ASSERT_EQ(cow.get({x, y}), grid[y * width + x]);
+    }
+  }
+  std::vector<Id> copy;
+  cow.copyTo(copy);
+  EXPECT_EQ(copy, grid);
+  EXPECT_EQ(cow.getChunkCount(), 3 * 2);
+}
+
+TEST(CowGridTest, CopiesOnlyTheChunksWritten) {
+  const int width = 100, height = 100;
+  auto grid = randomGrid(width, height, 2);
+  CowGrid original(grid, width, height);
+  CowGrid branch = original;
+  EXPECT_EQ(branch.countSharedChunks(original), original.getChunkCount());
+  branch.set({1, 1}, 9);
+  branch.set({2, 1}, 9);
+  branch.set({99, 99}, 9);
+  EXPECT_EQ(branch.countSharedChunks(original), original.getChunkCount() - 2);
+  EXPECT_EQ(branch.get({1, 1}), 9);
+  EXPECT_EQ(original.get({1, 1}), grid[1 * width + 1]);
+  EXPECT_EQ(original.get({99, 99}), grid[99 * width + 99]);
+  // Once the original is gone the branch owns its chunks and writes in place
+  original = CowGrid();
+  CowGrid other = branch;
+  other.set({50, 50}, 7);
+  EXPECT_EQ(branch.get({50, 50}), grid[50 * width + 50]);
+}
+
+TEST(CowGridTest, BranchesOnSeveralThreads) {
+  const int width = 64, height = 64;
+  auto grid = randomGrid(width, height, 3);
+  CowGrid root(grid, width, height);
+  std::vector<std::thread> threads;
+  std::vector<int> mismatches(4, 0);
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 1000; i++) {
+        CowGrid branch = root;
+        branch.set({(i * 7 + t) % width, (i * 13) % height}, Id(10 + t));
+        mismatches[t] += branch.get({(i * 7 + t) % width, (i * 13) % height}) != 10 + t;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto count : mismatches) {
+    EXPECT_EQ(count, 0);
+  }
+  std::vector<Id> copy;
+  root.copyTo(copy);
+  EXPECT_EQ(copy, grid);
+}
@@ -0,0 +1,99 @@
+//GTest tests for the frames replayed by relays
+#include"server/frame_log.h"
+#include"frame_codec.h"
+#include"protocol.h"
+#include"gtest/gtest.h"
+#include<random>
+using cycles::GameState;
+using cycles::Id;
+using cycles::protocol::FrameKind;
+using namespace cycles_server;
+
+// Players walking east on a grid that fills up frame after frame
+GameState makeState(int frame) {
+  GameState state;
+  state.gridWidth = 30;
+  state.gridHeight = 10;
+  state.frameNumber = frame;
+  state.serverTime = sf::milliseconds(33 * frame);
+  state.grid.assign(300, 0);
+  for (int p = 0; p < 3; p++) {
+    cycles::Player player{"p" + std::to_string(p), sf::Color(10, 20, 30),
+                          {frame % 30, p * 3}, Id(p + 1), {}};
+    for (int x = frame % 30; x >= 0; x--) {
+      state.grid[p * 3 * 30 + x] = player.id;
+      if (x < frame % 30) {
+        player.tail.push_back({x, p * 3});
+      }
+    }
+    state.players.push_back(player);
+  }
+  return state;
+}
+
+// Decodes the entries like a spectator taking deltas
+GameState replay(const std::vector<sf::Packet> &entries, GameState state) {
+  for (auto entry : entries) {
+    sf::Uint8 kind = 0;
+    EXPECT_TRUE(entry >> kind);
+    if (kind == static_cast<sf::Uint8>(FrameKind::keyframe)) {
+      EXPECT_TRUE(cycles::readFrame(entry, state));
+    } else {
+      EXPECT_TRUE(cycles::readDelta(entry, state));
+    }
+  }
+  return state;
+}
+
+void expectSameState(const GameState &a, const GameState &b) {
+  EXPECT_EQ(a.frameNumber, b.frameNumber);
+  EXPECT_EQ(a.serverTime, b.serverTime);
+  EXPECT_EQ(a.grid, b.grid);
+  ASSERT_EQ(a.players.size(), b.players.size());
+  for (std::size_t p = 0; p < a.players.size(); p++) {
+    EXPECT_EQ(a.players[p].name, b.players[p].name);
+    EXPECT_EQ(a.players[p].position, b.players[p].position);
+    EXPECT_EQ(a.players[p].tail, b.players[p].tail);
+  }
+}
+
+TEST(FrameLogTest, StartsKeyframesAtTheInterval) {
+  FrameLog log(4);
+  EXPECT_TRUE(log.isEmpty());
+  for (int frame = 0; frame < 6; frame++) {
+    log.add(makeState(frame));
+  }
+  // Frames 4 and 5: a keyframe and a delta
+  ASSERT_EQ(log.getEntries().size(), 2);
+  auto keyframe = log.getEntries()[0];
+  sf::Uint8 kind = 0;
+  EXPECT_TRUE(keyframe >> kind);
+  EXPECT_EQ(kind, static_cast<sf::Uint8>(FrameKind::keyframe));
+  EXPECT_LT(log.getEntries()[1].getDataSize(), log.getEntries()[0].getDataSize());
+}
+
+TEST(FrameLogTest, ReplayRebuildsTheLatestState) {
+  FrameLog log(10);
+  for (int frame = 0; frame < 17; frame++) {
+    log.add(makeState(frame));
+    expectSameState(replay(log.getEntries(), GameState()), makeState(frame));
+  }
+}
+
+TEST(FrameLogTest, DeltasFollowTheReplay) {
+  FrameLog log(100);
+  log.add(makeState(0));
+  auto state = replay(log.getEntries(), GameState());
+  for (int frame = 1; frame < 20; frame++) {
+    log.add(makeState(frame));
+    state = replay({log.getLatest()}, state);
+    expectSameState(state, makeState(frame));
+  }
+  // A delta computed from another frame is refused
+  log.add(makeState(20));
+  auto delta = log.getLatest();
+  sf::Uint8 kind;
+  delta >> kind;
+  auto old = makeState(5);
+  EXPECT_FALSE(cycles::readDelta(delta, old));
+}
@@ -0,0 +1,82 @@
+//GTest tests for the snapshots the server publishes for the renderer
+#include"server/allocation_counter.h"
+#include"server/frame_snapshot.h"
+#include"gtest/gtest.h"
+#include"test_config.h"
+#include<atomic>
+#include<thread>
+using namespace cycles_server;
+
+TEST(SnapshotPublisherTest, PublishesThePlayersOfTheFrame) {
+  Game game(testConfig(50, 50), 3);
+  SnapshotPublisher publisher;
+  ASSERT_NE(publisher.getLatest(), nullptr);
+  EXPECT_TRUE(publisher.getLatest()->players.empty());
+  auto first = game.addPlayer("first");
+  auto second = game.addPlayer("second");
+  game.setFrame(7);
+  publisher.publish(game);
+  auto snapshot = publisher.getLatest();
+  EXPECT_EQ(snapshot->frame, 7);
+  EXPECT_FALSE(snapshot->gameOver);
+  ASSERT_EQ(snapshot->players.size(), 2u);
+  const auto players = game.getPlayers();
+  for (const auto &player : snapshot->players) {
+    ASSERT_TRUE(player.id == first || player.id == second);
+    EXPECT_EQ(player.name, players.at(player.id).name);
+    EXPECT_EQ(player.position, players.at(player.id).position);
+  }
+}
+
+TEST(SnapshotPublisherTest, KeepsHeldSnapshotsAndReusesTheOthers) {
+  Game game(testConfig(50, 50), 3);
+  SnapshotPublisher publisher;
+  game.addPlayer("player");
+  game.setFrame(1);
+  publisher.publish(game);
+  auto held = publisher.getLatest();
+  for (int frame = 2; frame < 10; frame++) {
+    game.setFrame(frame);
+    publisher.publish(game);
+  }
+  // A reader's snapshot is never rewritten under it
+  EXPECT_EQ(held->frame, 1);
+  EXPECT_EQ(publisher.getLatest()->frame, 9);
+  held.reset();
+  const auto before = allocationCount();
+  for (int frame = 10; frame < 20; frame++) {
+    game.setFrame(frame);
+    publisher.publish(game);
+  }
+  EXPECT_EQ(allocationCount() - before, 0u);
+}
+
+TEST(SnapshotPublisherTest, ReaderSeesWholeFramesInOrder) {
+  // The game loop publishes while the renderer reads, as in the server
+  Game game(testConfig(50, 50), 5);
+  for (int p = 0; p < 10; p++) {
+    game.addPlayer("player" + std::to_string(p));
+  }
+  SnapshotPublisher publisher;
+  std::atomic<bool> done{false};
+  std::thread reader([&publisher, &done] {
+    int last = 0;
+    while (!done.load(std::memory_order_acquire)) {
+      auto snapshot = publisher.getLatest();
+      EXPECT_GE(snapshot->frame, last);
+      last = snapshot->frame;
+      if (snapshot->frame > 0) {
+        EXPECT_EQ(snapshot->players.size(), 10u);
+        for (const auto &player : snapshot->players) {
+          EXPECT_EQ(player.name, "player" + std::to_string(player.id - 1));
+        }
+      }
+    }
+  });
+  for (int frame = 1; frame <= 2000; frame++) {
+    game.setFrame(frame);
+    publisher.publish(game);
+  }
+  done.store(true, std::memory_order_release);
+  reader.join();
+}
@@ -0,0 +1,117 @@
+//GTest tests for the batched environments
+#include"server/game_batch.h"
+#include"gtest/gtest.h"
+#include"test_config.h"
+using cycles::Id;
+using namespace cycles_server;
+
+TEST(GameBatchTest, StepsEveryEnvironment) {
+  auto conf = testConfig(10, 10);
+  GameBatch batch(conf, 64, 2, 4, 1234);
+  std::vector<Direction> directions(batch.size() * 2, Direction::north);
+  std::vector<sf::Vector2i> before;
+  for (int env = 0; env < batch.size(); env++) {
+    before.push_back(
+        batch.getGame(env).getPlayers().at(batch.getPlayerId(env, 0)).position);
+  }
+  batch.step(directions);
+  for (int env = 0; env < batch.size(); env++) {
+    auto &game = batch.getGame(env);
+    const auto id = batch.getPlayerId(env, 0);
+    if (!batch.getDone()[env] && game.hasPlayer(id)) {
+      EXPECT_EQ(game.getPlayers().at(id).position, before[env] + sf::Vector2i(0, -1));
+      EXPECT_EQ(game.getFrame(), 1);
+    }
+  }
+}
+
+TEST(GameBatchTest, AutoResetsFinishedGames) {
+  auto conf = testConfig(10, 10);
+  GameBatch batch(conf, 8, 2, 1, 1234);
+  std::vector<Direction> directions(batch.size() * 2, Direction::north);
+  // Moving north on a 10x10 grid hits the wall within 10 frames
+  std::vector<int> episodesDone(batch.size(), 0);
+  for (int i = 0; i < 10; i++) {
+    batch.step(directions);
+    for (int env = 0; env < batch.size(); env++) {
+      episodesDone[env] += batch.getDone()[env];
+    }
+  }
+  batch.step(directions);
+  for (int env = 0; env < batch.size(); env++) {
+    EXPECT_GE(episodesDone[env], 1);
+    if (!batch.getDone()[env]) {
+      EXPECT_FALSE(batch.getGame(env).isGameOver());
+    }
+  }
+  for (auto flag : batch.getAlive()) {
+    EXPECT_TRUE(flag == 0 || flag == 1);
+  }
+}
+
+TEST(GameBatchTest, ShowsTheTerminalStepBeforeResetting) {
+  auto conf = testConfig(10, 10);
+  GameBatch batch(conf, 32, 2, 2, 99);
+  std::vector<Direction> directions(batch.size() * 2, Direction::north);
+  std::vector<bool> seen(batch.size(), false);
+  for (int i = 0; i < 12; i++) {
+    batch.step(directions);
+    for (int env = 0; env < batch.size(); env++) {
+      if (!batch.getDone()[env] || seen[env]) {
+        continue;
+      }
+      seen[env] = true;
+      // The game is left as it ended, with its dead players flagged
+      auto &game = batch.getGame(env);
+      EXPECT_TRUE(game.isGameOver());
+      EXPECT_GT(game.getFrame(), 0);
+      int alive = 0;
+      for (int p = 0; p < 2; p++) {
+        EXPECT_EQ(batch.getAlive()[env * 2 + p], game.hasPlayer(batch.getPlayerId(env, p)));
+        alive += batch.getAlive()[env * 2 + p];
+      }
+      EXPECT_LE(alive, 1);
+    }
+  }
+  // The step after the end starts a new episode, ignoring the directions
+  std::vector<int> ended;
+  for (int env = 0; env < batch.size(); env++) {
+    if (batch.getDone()[env]) {
+      ended.push_back(env);
+    }
+  }
+  batch.step(directions);
+  for (auto env : ended) {
+    EXPECT_FALSE(batch.getDone()[env]);
+    EXPECT_EQ(batch.getGame(env).getFrame(), 0);
+    EXPECT_EQ(batch.getAlive()[env * 2], 1);
+    EXPECT_EQ(batch.getAlive()[env * 2 + 1], 1);
+  }
+  for (int env = 0; env < batch.size(); env++) {
+    EXPECT_TRUE(seen[env]);
+  }
+}
+
+TEST(GameBatchTest, RejectsWrongNumberOfDirections) {
+  auto conf = testConfig(10, 10);
+  GameBatch batch(conf, 2, 2, 1);
+  std::vector<Direction> directions(3, Direction::north);
+  EXPECT_THROW(batch.step(directions), std::invalid_argument);
+}
+
+TEST(GameBatchTest, RejectsMorePlayersThanSpawnSlots) {
+  // minSpawnDistance 2 leaves room for a 2 by 2 lattice of slots
+  auto conf = testConfig(10, 10);
+  conf.minSpawnDistance = 2;
+  EXPECT_THROW(GameBatch(conf, 2, 5, 1), std::invalid_argument);
+  // The lattice follows the players, not conf.maxClients
+  conf = testConfig(100, 100);
+  conf.maxClients = 4;
+  GameBatch batch(conf, 2, 65, 1);
+  for (int env = 0; env < batch.size(); env++) {
+    EXPECT_EQ(batch.getGame(env).getPlayers().size(), 65);
+  }
+  for (auto flag : batch.getAlive()) {
+    EXPECT_EQ(flag, 1);
+  }
+}
@@ -1,5 +1,6 @@
 //GTest tests for game logic
 #include"server/game_logic.h"
+#include"test_config.h"
 #include"gtest/gtest.h"
 #include<fstream>
 using cycles::Id;
@@ -151,7 +152,182 @@ TEST(GameLogicTest, Grid){
   directions[id] = Direction::north;
   directions[id2] = Direction::south;
   game.movePlayers(directions);
-  auto grid = game.getGrid();
+  std::vector<sf::Uint8> grid;
+  game.getGrid().copyTo(grid);
   auto players = game.getPlayers();
   EXPECT_TRUE(test_grid(grid, players, conf));
 }
+
+TEST(GameLogicTest, TimestampTrailsMatchTailLists){
+  Configuration lists(writeConfig());
+  Configuration timestamps = lists;
+  timestamps.timestampTrails = true;
+  std::mt19937 rng(5);
+  for (int round = 0; round < 10; round++) {
+    Game listGame(lists, round);
+    Game timestampGame(timestamps, round);
+    for (int p = 0; p < 4; p++) {
+      listGame.addPlayer("player" + std::to_string(p));
+      timestampGame.addPlayer("player" + std::to_string(p));
+    }
+    // Short maximum tail lengths early on, so that tails get shortened
+    listGame.setFrame(-5400 + round * 100);
+    timestampGame.setFrame(listGame.getFrame());
+    for (int frame = 0; frame < 300 && !listGame.isGameOver(); frame++) {
+      std::map<Id, Direction> directions;
+      for (const auto &[id, player] : listGame.getPlayers()) {
+        // Mostly free cells, to keep the players alive for a while
+        int value = rng() % 4;
+        for (int turn = 0; turn < 4; turn++) {
+          auto next = player.position +
+                      cycles::getDirectionVector(cycles::getDirectionFromValue(value));
+          if (next.x >= 0 && next.y >= 0 && next.x < lists.gridWidth &&
+              next.y < lists.gridHeight && listGame.getCell(next.x, next.y) == 0) {
+            break;
+          }
+          value = (value + 1) % 4;
+        }
+        directions[id] = cycles::getDirectionFromValue(value);
+      }
+      listGame.movePlayers(directions);
+      timestampGame.movePlayers(directions);
+      listGame.setFrame(listGame.getFrame() + 1);
+      timestampGame.setFrame(timestampGame.getFrame() + 1);
+      auto players = listGame.getPlayers();
+      auto timestampPlayers = timestampGame.getPlayers();
+      ASSERT_EQ(players.size(), timestampPlayers.size());
+      for (const auto &[id, player] : players) {
+        ASSERT_EQ(timestampPlayers.at(id).position, player.position);
+        EXPECT_TRUE(timestampPlayers.at(id).tail.empty());
+      }
+      for (int y = 0; y < lists.gridHeight; y++) {
+        for (int x = 0; x < lists.gridWidth; x++) {
+          ASSERT_EQ(timestampGame.getCell(x, y), listGame.getCell(x, y));
+        }
+      }
+    }
+    std::vector<sf::Uint8> grid, timestampGrid;
+    listGame.getGrid().copyTo(grid);
+    timestampGame.getGrid().copyTo(timestampGrid);
+    EXPECT_EQ(timestampGrid, grid);
+  }
+}
+
+TEST(GameLogicTest, RulePoliciesChangeTheOutcome){
+  Configuration conf(writeConfig());
+  for (bool timestamps : {false, true}) {
+    conf.timestampTrails = timestamps;
+    // Heading north forever: a solid border kills within a lap, a wrapping
+    // one does not, unless the tail grows as long as the lap
+    for (auto [wrapping, uncapped] : {std::pair{false, false}, {true, false},
+                                      {true, true}}) {
+      conf.wrappingBorders = wrapping;
+      conf.uncappedTails = uncapped;
+      Game game(conf, 3);
+      Id id = game.addPlayer("player");
+      auto start = game.getPlayers()[id].position;
+      int moves = 0;
+      for (; moves < 300 && game.hasPlayer(id); moves++) {
+        game.movePlayers({{id, Direction::north}});
+        game.setFrame(game.getFrame() + 1);
+      }
+      if (!wrapping) {
+        EXPECT_EQ(moves, start.y + 1);
+      } else if (uncapped) {
+        EXPECT_EQ(moves, conf.gridHeight);
+      } else {
+        ASSERT_TRUE(game.hasPlayer(id));
+        auto position = game.getPlayers()[id].position;
+        EXPECT_EQ(position.x, start.x);
+        EXPECT_EQ(position.y, ((start.y - 300) % 100 + 100) % 100);
+      }
+    }
+  }
+  static_assert(HeadOnKillsBoth::kills(10, 3) && HeadOnKillsBoth::kills(3, 10));
+  static_assert(!HeadOnLongerTailWins::kills(10, 3) &&
+                HeadOnLongerTailWins::kills(3, 10) &&
+                HeadOnLongerTailWins::kills(3, 3));
+}
+
+// Two players on a row meet head-on in the cell between them, after the
+// left one made a detour that lengthens its tail by four cells if asked.
+// Returns whether the left and the right player survived.
+std::pair<bool, bool> playHeadOn(Configuration conf, bool detour) {
+  // A lattice of two slots side by side
+  conf.gridWidth = 20;
+  conf.gridHeight = 10;
+  conf.maxClients = 2;
+  conf.minSpawnDistance = 1;
+  // Spawns are random, so look for a seed that puts them on the same row an
+  // even number of cells apart
+  for (unsigned int seed = 0; seed < 1000; seed++) {
+    Game game(conf, seed);
+    Id left = game.addPlayer("left");
+    Id right = game.addPlayer("right");
+    auto leftStart = game.getPlayers()[left].position;
+    auto rightStart = game.getPlayers()[right].position;
+    if (leftStart.y != rightStart.y || (rightStart.x - leftStart.x) % 2 != 0) {
+      continue;
+    }
+    if (leftStart.x > rightStart.x) {
+      std::swap(left, right);
+      std::swap(leftStart, rightStart);
+    }
+    int gap = rightStart.x - leftStart.x;
+    if (detour) {
+      for (auto direction : {Direction::north, Direction::east,
+                             Direction::east, Direction::south}) {
+        game.movePlayers(std::map<Id, Direction>{{left, direction}});
+      }
+      gap -= 2;
+    }
+    for (int step = 0; step < gap / 2; step++) {
+      game.movePlayers(std::map<Id, Direction>{{left, Direction::east},
+                                               {right, Direction::west}});
+    }
+    return {game.hasPlayer(left), game.hasPlayer(right)};
+  }
+  ADD_FAILURE() << "No seed spawns the players on the same row";
+  return {false, false};
+}
+
+TEST(GameLogicTest, LongerTailWinsHeadOn){
+  Configuration conf(writeConfig());
+  for (bool timestamps : {false, true}) {
+    conf.timestampTrails = timestamps;
+    conf.longerTailWinsHeadOn = false;
+    EXPECT_EQ(playHeadOn(conf, true), std::pair(false, false));
+    conf.longerTailWinsHeadOn = true;
+    // The longer tail survives, equal tails both die
+    EXPECT_EQ(playHeadOn(conf, true), std::pair(true, false));
+    EXPECT_EQ(playHeadOn(conf, false), std::pair(false, false));
+  }
+}
+
+TEST(GameLogicTest, AddPlayerFailsWithoutRoom){
+  Configuration conf(writeConfig());
+  conf.gridWidth = 10;
+  conf.gridHeight = 10;
+  conf.minSpawnDistance = 2;
+  Game game(conf, 9);
+  // A 2 by 2 lattice of spawn slots
+  for (int p = 0; p < 4; p++) {
+    EXPECT_NE(game.addPlayer("player"), 0);
+  }
+  EXPECT_EQ(game.addPlayer("player"), 0);
+  EXPECT_EQ(game.getPlayers().size(), 4);
+}
+
+TEST(GameLogicTest, TimestampTrailsKeepTheWallIdForTheBorder){
+  auto conf = testConfig(100, 100);
+  conf.timestampTrails = true;
+  conf.maxClients = 300;
+  conf.minSpawnDistance = 1;
+  Game game(conf);
+  for (int p = 1; p < cycles::wallCell; p++) {
+    ASSERT_EQ(game.addPlayer("player"), p);
+  }
+  // Id 255 would read as the wall around the grid
+  EXPECT_EQ(game.addPlayer("player"), 0);
+  EXPECT_EQ(game.getPlayers().size(), cycles::wallCell - 1);
+}
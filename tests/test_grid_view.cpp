@@ -0,0 +1,57 @@
+//GTest tests for the padded grid view of game states
+#include"api.h"
+#include"gtest/gtest.h"
+#include<random>
+using cycles::GameState;
+using cycles::GridView;
+
+GameState randomState(int width, int height, sf::Vector2i offset, unsigned int seed) {
+  std::mt19937 rng(seed);
+  GameState state;
+  state.gridWidth = width;
+  state.gridHeight = height;
+  state.windowOffset = offset;
+  state.grid.resize(width * height);
+  for (auto &cell : state.grid) {
+    cell = rng() % 3 == 0 ? 1 + rng() % 4 : 0;
+  }
+  state.updateOccupancy();
+  return state;
+}
+
+TEST(GridViewTest, ReadsTheGridAndItsWalls) {
+  auto state = randomState(13, 7, {0, 0}, 1);
+  auto view = state.getGridView();
+  EXPECT_EQ(view.getStride(), 15);
+  for (int y = -1; y <= 7; y++) {
+    for (int x = -1; x <= 13; x++) {
+      if (state.isInsideGrid({x, y})) {
+        ASSERT_EQ(view.get({x, y}), state.getGridCell({x, y}));
+      } else {
+        ASSERT_EQ(view.get({x, y}), cycles::wallCell);
+        ASSERT_FALSE(view.isFree({x, y}));
+      }
+    }
+  }
+}
+
+TEST(GridViewTest, MatchesBoundsChecks) {
+  // A window of a larger arena
+  auto state = randomState(40, 25, {64, 32}, 2);
+  auto view = state.getGridView();
+  for (int y = 32; y < 57; y++) {
+    for (int x = 64; x < 104; x++) {
+      std::uint8_t expected = 0;
+      for (int d = 0; d < 4; d++) {
+        auto next = sf::Vector2i(x, y) +
+                    cycles::getDirectionVector(cycles::getDirectionFromValue(d));
+        if (state.isInsideGrid(next) && state.isCellEmpty(next)) {
+          expected |= 1 << d;
+        }
+      }
+      ASSERT_EQ(view.getFreeNeighbors({x, y}), expected);
+      ASSERT_EQ(view.getFreeNeighbors({x, y}),
+                state.getOccupancy().getFreeNeighbors({x - 64, y - 32}));
+    }
+  }
+}
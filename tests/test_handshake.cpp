@@ -0,0 +1,44 @@
+//GTest tests for the handshake shared by the server and the relay
+#include"server/handshake.h"
+#include"protocol.h"
+#include"gtest/gtest.h"
+using namespace cycles_server;
+namespace protocol = cycles::protocol;
+
+TEST(HandshakeTest, ReadsWhatTheClientsSend) {
+  // A bot over UDP, as written by Connection::connect
+  sf::Packet bot;
+  bot << std::string("bot") << sf::Uint8(protocol::udpCapability)
+      << sf::Uint16(4242);
+  auto request = readHandshake(bot);
+  EXPECT_EQ(request.name, "bot");
+  EXPECT_EQ(request.udpPort, 4242);
+  EXPECT_EQ(request.interval, 0);
+  // A spectator, as written by Connection::spectate
+  sf::Packet spectator;
+  spectator << std::string("viewer")
+            << sf::Uint8(protocol::spectatorCapability) << sf::Uint16(5);
+  request = readHandshake(spectator);
+  EXPECT_EQ(request.name, "viewer");
+  EXPECT_EQ(request.capabilities, protocol::spectatorCapability);
+  EXPECT_EQ(request.interval, 5);
+  // Older clients only send their name
+  sf::Packet old;
+  old << std::string("old");
+  request = readHandshake(old);
+  EXPECT_EQ(request.name, "old");
+  EXPECT_EQ(request.capabilities, 0);
+}
+
+TEST(HandshakeTest, RepliesToSpectatorsLikeToPlayers) {
+  sf::Packet reply;
+  writeSpectatorReply(reply, 3, true);
+  sf::Uint8 r, g, b, transport, deltas;
+  sf::Uint32 slot;
+  sf::Uint16 interval;
+  ASSERT_TRUE(reply >> r >> g >> b >> transport >> slot >> interval >> deltas);
+  EXPECT_EQ(transport, static_cast<sf::Uint8>(protocol::Transport::tcp));
+  EXPECT_EQ(interval, 3);
+  EXPECT_EQ(deltas, 1);
+  EXPECT_TRUE(reply.endOfPacket());
+}
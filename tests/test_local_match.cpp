@@ -0,0 +1,144 @@
+//GTest tests for the in-process match runner
+#include"server/allocation_counter.h"
+#include"server/local_match.h"
+#include"gtest/gtest.h"
+#include"test_config.h"
+#include<thread>
+using cycles::Id;
+using namespace cycles_server;
+
+// Moves in the first free direction, starting from a preferred one
+void runBot(cycles::LocalConnection connection, Direction preferred, int &movesSent) {
+  while (connection.isActive()) {
+    auto state = connection.receiveGameState();
+    if (!connection.isActive()) {
+      break;
+    }
+    sf::Vector2i position;
+    for (const auto &player : state.players) {
+      if (player.name == "bot" + std::to_string(int(preferred))) {
+        position = player.position;
+      }
+    }
+    auto direction = preferred;
+    for (int i = 0; i < 4; i++) {
+      auto candidate = cycles::getDirectionFromValue((int(preferred) + i) % 4);
+      auto next = position + cycles::getDirectionVector(candidate);
+      if (state.isInsideGrid(next) && state.isCellEmpty(next)) {
+        direction = candidate;
+        break;
+      }
+    }
+    connection.sendMove(direction);
+    movesSent++;
+  }
+}
+
+TEST(LocalMatchTest, PlaysUntilGameOver) {
+  auto conf = testConfig(20, 20);
+  auto game = std::make_shared<Game>(conf);
+  LocalMatch match(game);
+  int moves0 = 0, moves1 = 0;
+  std::thread bot0(runBot, match.connect("bot0"), Direction::north, std::ref(moves0));
+  std::thread bot1(runBot, match.connect("bot2"), Direction::south, std::ref(moves1));
+  match.run(2000);
+  bot0.join();
+  bot1.join();
+  EXPECT_GT(match.getFrame(), 0);
+  EXPECT_GT(moves0, 0);
+  EXPECT_GT(moves1, 0);
+  EXPECT_TRUE(game->isGameOver() || match.getFrame() == 2000);
+}
+
+TEST(LocalMatchTest, SilentBotTimesOut) {
+  auto conf = testConfig(20, 20);
+  auto game = std::make_shared<Game>(conf);
+  LocalMatch match(game);
+  match.setMoveTimeout(sf::milliseconds(5));
+  auto connection0 = match.connect("silent0");
+  auto connection1 = match.connect("silent1");
+  EXPECT_FALSE(match.step());
+  EXPECT_FALSE(connection0.isActive());
+  EXPECT_FALSE(connection1.isActive());
+  EXPECT_TRUE(game->getPlayers().empty());
+}
+
+TEST(LocalMatchTest, StatesAdvertiseTheMoveDeadline) {
+  auto conf = testConfig(20, 20);
+  auto game = std::make_shared<Game>(conf);
+  LocalMatch match(game);
+  match.setMoveTimeout(sf::milliseconds(40));
+  auto connection0 = match.connect("bot0");
+  auto connection1 = match.connect("bot1");
+  std::thread stepper([&match] { match.step(); });
+  auto state = connection0.receiveGameState();
+  connection0.sendMove(Direction::north);
+  connection1.receiveGameState();
+  connection1.sendMove(Direction::south);
+  stepper.join();
+  EXPECT_EQ(state.moveBudget, sf::milliseconds(40));
+  EXPECT_LE(state.getRemainingTime(), sf::milliseconds(40));
+}
+
+// Heads for the direction with the longest free run
+void runRunner(cycles::LocalConnection connection, std::string name) {
+  while (connection.isActive()) {
+    auto state = connection.receiveGameState();
+    if (!connection.isActive()) {
+      break;
+    }
+    sf::Vector2i position;
+    for (const auto &player : state.players) {
+      if (player.name == name) {
+        position = player.position;
+      }
+    }
+    auto direction = Direction::north;
+    int longest = -1;
+    for (int value = 0; value < 4; value++) {
+      auto candidate = cycles::getDirectionFromValue(value);
+      auto next = position + cycles::getDirectionVector(candidate);
+      int run = 0;
+      while (run < 20 && state.isInsideGrid(next) && state.isCellEmpty(next)) {
+        next += cycles::getDirectionVector(candidate);
+        run++;
+      }
+      if (run > longest) {
+        longest = run;
+        direction = candidate;
+      }
+    }
+    connection.sendMove(direction);
+  }
+}
+
+// Covers the engine and the in-process channels a local match steps through,
+// not the networked frame loop of the server
+TEST(LocalMatchTest, SixtyPlayerStepsAllocateNothingOnceWarm) {
+  auto conf = testConfig(100, 100);
+  auto game = std::make_shared<Game>(conf, 21);
+  LocalMatch match(game);
+  std::vector<std::thread> bots;
+  for (int p = 0; p < 60; p++) {
+    auto name = "runner" + std::to_string(p);
+    bots.emplace_back(runRunner, match.connect(name), name);
+  }
+  // Tails reach their maximum length, and the buffers their size
+  for (int frame = 0; frame < 80; frame++) {
+    ASSERT_TRUE(match.step());
+  }
+  int measured = 0;
+  for (; measured < 100; measured++) {
+    const auto before = allocationCount();
+    if (!match.step()) {
+      break;
+    }
+    EXPECT_EQ(allocationCount() - before, 0u) << "frame " << match.getFrame();
+  }
+  EXPECT_GT(measured, 0);
+  // Closes the channels, so that the bots return
+  match.run(match.getFrame());
+  for (auto &bot : bots) {
+    bot.join();
+  }
+}
@@ -0,0 +1,91 @@
+//GTest tests for the move board between the input threads and the game loop
+#include"server/move_board.h"
+#include"gtest/gtest.h"
+#include<atomic>
+#include<thread>
+#include<vector>
+using cycles::Direction;
+using cycles::Id;
+using cycles_server::MoveBoard;
+
+TEST(MoveBoardTest, KeepsTheNewestMoveOfAFrame) {
+  MoveBoard board;
+  Direction direction;
+  EXPECT_FALSE(board.take(1, 0, direction));
+  board.post(1, 0, Direction::east, 5);
+  ASSERT_TRUE(board.take(1, 0, direction));
+  EXPECT_EQ(direction, Direction::east);
+  EXPECT_FALSE(board.take(1, 1, direction));
+  EXPECT_FALSE(board.take(2, 0, direction));
+  // An older sequence number loses, a newer one wins, even across 255
+  board.post(1, 0, Direction::west, 4);
+  ASSERT_TRUE(board.take(1, 0, direction));
+  EXPECT_EQ(direction, Direction::east);
+  board.post(1, 0, Direction::south, 100);
+  ASSERT_TRUE(board.take(1, 0, direction));
+  EXPECT_EQ(direction, Direction::south);
+  // A new frame replaces the move whatever its sequence number, and a move
+  // for an older frame arriving late is dropped
+  board.post(1, 1, Direction::south, 250);
+  board.post(1, 0, Direction::east, 251);
+  ASSERT_TRUE(board.take(1, 1, direction));
+  EXPECT_EQ(direction, Direction::south);
+  EXPECT_FALSE(board.take(1, 0, direction));
+  board.post(1, 1, Direction::north, 2);
+  ASSERT_TRUE(board.take(1, 1, direction));
+  EXPECT_EQ(direction, Direction::north);
+  EXPECT_FALSE(board.isClosed(1));
+  board.close(1);
+  EXPECT_TRUE(board.isClosed(1));
+}
+
+// The direction every poster sends for a player in a frame, so that a move
+// read for the wrong frame or a torn word shows up
+Direction expected(Id id, int frame) {
+  return cycles::getDirectionFromValue((id + frame) % 4);
+}
+
+TEST(MoveBoardTest, StressManyPostersOneReader) {
+  // Several threads post for every player, as duplicated UDP moves and a
+  // TCP reader could, while the game loop collects frame after frame
+  constexpr int players = 60, posters = 4, frames = 100;
+  MoveBoard board;
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < posters; t++) {
+    threads.emplace_back([&board, &done] {
+      std::uint8_t sequence = 0;
+      while (!done.load(std::memory_order_acquire)) {
+        const int frame = board.getFrame();
+        if (frame < 0) {
+          continue;
+        }
+        for (int p = 1; p <= players; p++) {
+          board.post(p, frame, expected(p, frame), sequence++);
+        }
+      }
+    });
+  }
+  // Failures stop collecting but never skip joining the posters
+  bool mismatch = false;
+  for (int frame = 0; frame < frames && !mismatch; frame++) {
+    board.setFrame(frame);
+    int collected = 0;
+    std::vector<bool> seen(players + 1, false);
+    while (collected < players && !mismatch) {
+      for (int p = 1; p <= players; p++) {
+        Direction direction;
+        if (!seen[p] && board.take(p, frame, direction)) {
+          EXPECT_EQ(direction, expected(p, frame)) << "player " << p;
+          mismatch = mismatch || direction != expected(p, frame);
+          seen[p] = true;
+          collected++;
+        }
+      }
+    }
+  }
+  done.store(true, std::memory_order_release);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
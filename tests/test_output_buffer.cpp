@@ -0,0 +1,48 @@
+//GTest tests for the server's per-client output buffers
+#include"server/output_buffer.h"
+#include"gtest/gtest.h"
+using namespace cycles_server;
+
+sf::Packet makePacket(sf::Uint16 value) {
+  sf::Packet packet;
+  packet << value;
+  return packet;
+}
+
+TEST(OutputBufferTest, FramesPacketsLikeSfml) {
+  OutputBuffer buffer(64);
+  ASSERT_TRUE(buffer.push(makePacket(0x1234)));
+  auto pending = buffer.pending();
+  ASSERT_EQ(pending.size(), 6);
+  const std::byte expected[] = {std::byte(0), std::byte(0), std::byte(0),
+                                std::byte(2), std::byte(0x12), std::byte(0x34)};
+  for (std::size_t i = 0; i < pending.size(); i++) {
+    EXPECT_EQ(pending[i], expected[i]);
+  }
+}
+
+TEST(OutputBufferTest, ResumesPartialWrites) {
+  OutputBuffer buffer(64);
+  buffer.push(makePacket(0x1234));
+  buffer.consume(4);
+  EXPECT_EQ(buffer.size(), 2);
+  // New packets go after the bytes that are still waiting
+  buffer.push(makePacket(0x5678));
+  auto pending = buffer.pending();
+  ASSERT_EQ(pending.size(), 8);
+  EXPECT_EQ(pending[0], std::byte(0x12));
+  EXPECT_EQ(pending[1], std::byte(0x34));
+  EXPECT_EQ(pending[7], std::byte(0x78));
+  buffer.consume(8);
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST(OutputBufferTest, RefusesPacketsOverHighWaterMark) {
+  OutputBuffer buffer(12);
+  EXPECT_TRUE(buffer.push(makePacket(1)));
+  EXPECT_TRUE(buffer.push(makePacket(2)));
+  EXPECT_FALSE(buffer.push(makePacket(3)));
+  EXPECT_EQ(buffer.size(), 12);
+  buffer.consume(6);
+  EXPECT_TRUE(buffer.push(makePacket(3)));
+}
@@ -0,0 +1,107 @@
+//GTest tests for the wire protocol helpers
+#include"protocol.h"
+#include"gtest/gtest.h"
+#include<cstring>
+using namespace cycles::protocol;
+
+std::vector<std::vector<std::byte>> fragment(int frame, const std::vector<std::byte> &data) {
+  std::vector<std::vector<std::byte>> datagrams;
+  const auto count = (data.size() + udpFragmentPayload - 1) / udpFragmentPayload;
+  for (std::size_t index = 0; index < count; index++) {
+    const auto offset = index * udpFragmentPayload;
+    const auto payload = std::min(udpFragmentPayload, data.size() - offset);
+    std::vector<std::byte> datagram(udpFragmentHeaderSize + payload);
+    writeFragmentHeader({frame, sf::Uint16(index), sf::Uint16(count)}, datagram.data());
+    std::memcpy(datagram.data() + udpFragmentHeaderSize, data.data() + offset, payload);
+    datagrams.push_back(datagram);
+  }
+  return datagrams;
+}
+
+std::vector<std::byte> makeFrame(std::size_t size, int seed) {
+  std::vector<std::byte> data(size);
+  for (std::size_t i = 0; i < size; i++) {
+    data[i] = std::byte((i * 31 + seed) & 0xFF);
+  }
+  return data;
+}
+
+TEST(ProtocolTest, CompactMoveRoundTrip) {
+  for (int frame : {0, 1, 99, 16383, 16384, 123456}) {
+    for (int direction = 0; direction < 4; direction++) {
+      int decoded = -1;
+      EXPECT_TRUE(decodeMove(encodeMove(frame, direction), frame, decoded));
+      EXPECT_EQ(decoded, direction);
+    }
+  }
+}
+
+TEST(ProtocolTest, CompactMoveRejectsOtherFrames) {
+  int direction = -1;
+  EXPECT_FALSE(decodeMove(encodeMove(41, 2), 42, direction));
+  EXPECT_FALSE(decodeMove(encodeMove(43, 2), 42, direction));
+  EXPECT_EQ(direction, -1);
+}
+
+TEST(ProtocolTest, UdpMoveRoundTrip) {
+  std::byte datagram[udpMoveSize];
+  writeUdpMove({encodeMove(1234567, 3), 200}, datagram);
+  UdpMove move;
+  ASSERT_TRUE(readUdpMove(datagram, udpMoveSize, move));
+  EXPECT_EQ(move.move, encodeMove(1234567, 3));
+  EXPECT_EQ(move.sequence, 200);
+  EXPECT_FALSE(readUdpMove(datagram, udpMoveSize - 1, move));
+}
+
+TEST(ProtocolTest, AssemblesOutOfOrderFragments) {
+  auto data = makeFrame(5000, 1);
+  auto datagrams = fragment(7, data);
+  FrameAssembler assembler;
+  for (std::size_t i = datagrams.size(); i-- > 0;) {
+    EXPECT_EQ(assembler.add(datagrams[i].data(), datagrams[i].size()), i == 0);
+  }
+  EXPECT_EQ(assembler.getCompletedFrame(), 7);
+  EXPECT_EQ(assembler.getCompleted(), data);
+}
+
+TEST(ProtocolTest, DropsStaleFrames) {
+  auto newer = fragment(10, makeFrame(3000, 2));
+  auto older = fragment(9, makeFrame(3000, 3));
+  FrameAssembler assembler;
+  // A frame missing a fragment is abandoned when a newer one arrives
+  assembler.add(older[0].data(), older[0].size());
+  for (auto &datagram : newer) {
+    assembler.add(datagram.data(), datagram.size());
+  }
+  EXPECT_EQ(assembler.getCompletedFrame(), 10);
+  for (auto &datagram : older) {
+    EXPECT_FALSE(assembler.add(datagram.data(), datagram.size()));
+  }
+  EXPECT_EQ(assembler.getCompletedFrame(), 10);
+  EXPECT_EQ(assembler.getCompleted(), makeFrame(3000, 2));
+}
+
+TEST(ProtocolTest, DropsFramesOverCapacity) {
+  // A forged header must not make the assembler reserve a huge buffer
+  FrameAssembler assembler(3 * udpFragmentPayload);
+  for (auto &datagram : fragment(4, makeFrame(5000, 1))) {
+    EXPECT_FALSE(assembler.add(datagram.data(), datagram.size()));
+  }
+  EXPECT_EQ(assembler.getCompletedFrame(), -1);
+  auto fits = fragment(5, makeFrame(3 * udpFragmentPayload, 2));
+  for (std::size_t i = 0; i < fits.size(); i++) {
+    EXPECT_EQ(assembler.add(fits[i].data(), fits[i].size()), i + 1 == fits.size());
+  }
+  EXPECT_EQ(assembler.getCompletedFrame(), 5);
+}
+
+TEST(ProtocolTest, PacksTails) {
+  sf::Vector2i head(5, 5);
+  std::vector<sf::Vector2i> tail = {{5, 6}, {4, 6}, {4, 5}, {4, 4}, {5, 4}, {6, 4}};
+  std::vector<sf::Uint8> packed;
+  packTail(head, tail, packed);
+  EXPECT_EQ(packed.size(), packedTailSize(tail.size()));
+  std::vector<sf::Vector2i> unpacked;
+  unpackTail(head, packed.data(), tail.size(), unpacked);
+  EXPECT_EQ(unpacked, tail);
+}
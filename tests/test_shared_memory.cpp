@@ -0,0 +1,131 @@
+//GTest tests for the shared memory segment of local clients
+#include"shared_memory.h"
+#include"frame_codec.h"
+#include"protocol.h"
+#include"gtest/gtest.h"
+#include<thread>
+#include<unistd.h>
+#include<vector>
+using namespace cycles;
+
+// A segment name no other test process uses
+std::string segmentName(const std::string &test) {
+  return "/cycles_test_" + test + "_" + std::to_string(getpid());
+}
+
+TEST(SharedFrameBufferTest, PublishesFramesToClients) {
+  auto server = SharedFrameBuffer::create(segmentName("publish"), 64, 4);
+  ASSERT_NE(server, nullptr);
+  auto client = SharedFrameBuffer::open(segmentName("publish"));
+  ASSERT_NE(client, nullptr);
+  EXPECT_EQ(client->getClientSlots(), 4);
+  sf::Packet packet;
+  int frame = -1;
+  EXPECT_FALSE(client->readFrame(-1, packet, frame));
+  const std::vector<std::byte> data(40, std::byte(7));
+  ASSERT_TRUE(server->publishFrame(3, data.data(), data.size()));
+  ASSERT_TRUE(client->readFrame(-1, packet, frame));
+  EXPECT_EQ(frame, 3);
+  ASSERT_EQ(packet.getDataSize(), data.size());
+  EXPECT_EQ(std::memcmp(packet.getData(), data.data(), data.size()), 0);
+  // Only newer frames are copied
+  EXPECT_FALSE(client->readFrame(3, packet, frame));
+}
+
+TEST(SharedFrameBufferTest, RefusesFramesOverCapacity) {
+  auto server = SharedFrameBuffer::create(segmentName("capacity"), 64, 1);
+  ASSERT_NE(server, nullptr);
+  const std::vector<std::byte> fits(64), overflows(65);
+  ASSERT_TRUE(server->publishFrame(0, fits.data(), fits.size()));
+  EXPECT_FALSE(server->publishFrame(1, overflows.data(), overflows.size()));
+  // Clients keep seeing the last frame that fit
+  sf::Packet packet;
+  int frame = -1;
+  ASSERT_TRUE(server->readFrame(-1, packet, frame));
+  EXPECT_EQ(frame, 0);
+}
+
+TEST(SharedFrameBufferTest, FrameOfLongestNamesFitsItsCapacity) {
+  // The server sizes the segment with maxFrameSize and cuts longer names
+  constexpr int width = 60, height = 30, players = 60;
+  GameState state;
+  state.gridWidth = width;
+  state.gridHeight = height;
+  state.arenaSize = {width, height};
+  state.grid.assign(width * height, 1);
+  state.players.resize(players);
+  for (int p = 0; p < players; p++) {
+    auto &player = state.players[p];
+    player.name.assign(protocol::maxNameLength, 'x');
+    player.id = p + 1;
+    player.position = {p, 0};
+    // The heads share a row and the tails fill the rest of the grid
+    for (int y = 1; y < height; y++) {
+      player.tail.push_back({p, y});
+    }
+  }
+  sf::Packet packet;
+  writeFrame(packet, state);
+  const auto capacity = protocol::maxFrameSize(width * height, players);
+  EXPECT_LE(packet.getDataSize(), capacity);
+  auto server = SharedFrameBuffer::create(segmentName("names"), capacity, 1);
+  ASSERT_NE(server, nullptr);
+  EXPECT_TRUE(server->publishFrame(0, packet.getData(), packet.getDataSize()));
+}
+
+TEST(SharedFrameBufferTest, ReadersNeverSeeATornFrame) {
+  auto server = SharedFrameBuffer::create(segmentName("torn"), 4096, 1);
+  ASSERT_NE(server, nullptr);
+  auto client = SharedFrameBuffer::open(segmentName("torn"));
+  ASSERT_NE(client, nullptr);
+  constexpr int frames = 20000;
+  std::thread writer([&server] {
+    std::vector<std::byte> data;
+    for (int frame = 0; frame < frames; frame++) {
+      // Every byte of a frame holds its number, and sizes vary
+      data.assign(1024 + frame % 3000, std::byte(frame));
+      server->publishFrame(frame, data.data(), data.size());
+    }
+  });
+  int last = -1;
+  sf::Packet packet;
+  // Until the last frame is read, whatever frames the writer laps
+  while (last < frames - 1) {
+    int frame;
+    if (!client->readFrame(last, packet, frame)) {
+      continue;
+    }
+    EXPECT_GT(frame, last);
+    EXPECT_EQ(packet.getDataSize(), 1024u + frame % 3000);
+    const auto *bytes = static_cast<const std::byte *>(packet.getData());
+    bool whole = true;
+    for (std::size_t i = 0; i < packet.getDataSize(); i++) {
+      whole = whole && bytes[i] == std::byte(frame);
+    }
+    EXPECT_TRUE(whole) << "frame " << frame;
+    last = frame;
+  }
+  writer.join();
+}
+
+TEST(SharedFrameBufferTest, MoveSlotsHoldOneMovePerFrame) {
+  auto server = SharedFrameBuffer::create(segmentName("moves"), 64, 2);
+  ASSERT_NE(server, nullptr);
+  auto client = SharedFrameBuffer::open(segmentName("moves"));
+  ASSERT_NE(client, nullptr);
+  Direction direction;
+  EXPECT_FALSE(server->takeMove(0, 0, direction));
+  client->postMove(0, 5, Direction::west);
+  ASSERT_TRUE(server->takeMove(0, 5, direction));
+  EXPECT_EQ(direction, Direction::west);
+  // Stale and other slots' moves are not taken
+  EXPECT_FALSE(server->takeMove(0, 6, direction));
+  EXPECT_FALSE(server->takeMove(1, 5, direction));
+  EXPECT_FALSE(client->isSlotClosed(0));
+  server->closeSlot(0);
+  EXPECT_TRUE(client->isSlotClosed(0));
+  // A reopened slot starts empty for its new client
+  server->openSlot(0);
+  EXPECT_FALSE(client->isSlotClosed(0));
+  EXPECT_FALSE(server->takeMove(0, 5, direction));
+}
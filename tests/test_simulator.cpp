@@ -0,0 +1,123 @@
+//GTest tests for the client-side forward simulator
+#include"simulator.h"
+#include"server/game_logic.h"
+#include"gtest/gtest.h"
+#include"test_config.h"
+#include<random>
+using cycles::Id;
+using namespace cycles_server;
+
+// What a client would receive for the current state of the game
+cycles::GameState snapshot(Game &game, const Configuration &conf) {
+  cycles::GameState state;
+  game.getGrid().copyTo(state.grid);
+  state.gridWidth = conf.gridWidth;
+  state.gridHeight = conf.gridHeight;
+  state.frameNumber = game.getFrame();
+  for (const auto &[id, player] : game.getPlayers()) {
+    state.players.push_back({player.name, player.color, player.position, id,
+                             {player.tail.begin(), player.tail.end()}});
+  }
+  return state;
+}
+
+void expectSameGame(const cycles::Simulator &simulator, Game &game,
+                    const std::vector<cycles::Player> &players, const Configuration &conf) {
+  auto alive = game.getPlayers();
+  EXPECT_EQ(simulator.getAliveCount(), alive.size());
+  for (int p = 0; p < int(players.size()); p++) {
+    auto it = alive.find(players[p].id);
+    ASSERT_EQ(simulator.isAlive(p), it != alive.end());
+    if (it != alive.end()) {
+      EXPECT_EQ(simulator.getPosition(p), it->second.position);
+    }
+  }
+  const auto &grid = game.getGrid();
+  for (int y = 0; y < conf.gridHeight; y++) {
+    for (int x = 0; x < conf.gridWidth; x++) {
+      ASSERT_EQ(simulator.getGridCell({x, y}), grid.get(x, y));
+    }
+  }
+}
+
+TEST(SimulatorTest, MatchesServerRules) {
+  auto conf = testConfig(24, 24);
+  std::mt19937 rng(7);
+  for (int round = 0; round < 20; round++) {
+    Game game(conf);
+    for (int p = 0; p < 3; p++) {
+      game.addPlayer("player" + std::to_string(p));
+    }
+    // Early negative frames have short maximum tail lengths, so that tails
+    // get shortened before the bots trap themselves
+    game.setFrame(-5300 + round * 300);
+    auto state = snapshot(game, conf);
+    cycles::Simulator simulator(state, 200);
+    std::vector<Direction> directions(state.players.size());
+    for (int frame = 0; frame < 200 && !simulator.isGameOver(); frame++) {
+      std::map<Id, Direction> moves;
+      for (int p = 0; p < int(directions.size()); p++) {
+        // Mostly legal moves, sometimes a random one to cause collisions
+        auto legal = simulator.getLegalMoves(p);
+        int value = rng() % 4;
+        if (legal != 0 && rng() % 8 != 0) {
+          while (!(legal & (1 << value))) {
+            value = (value + 1) % 4;
+          }
+        }
+        directions[p] = cycles::getDirectionFromValue(value);
+        if (simulator.isAlive(p)) {
+          moves[state.players[p].id] = directions[p];
+        }
+      }
+      simulator.make(directions);
+      game.movePlayers(moves);
+      game.setFrame(game.getFrame() + 1);
+      expectSameGame(simulator, game, state.players, conf);
+    }
+  }
+}
+
+TEST(SimulatorTest, UnmakeRestoresTheState) {
+  auto conf = testConfig(24, 24);
+  Game game(conf);
+  for (int p = 0; p < 4; p++) {
+    game.addPlayer("player" + std::to_string(p));
+  }
+  auto state = snapshot(game, conf);
+  cycles::Simulator simulator(state, 64);
+  std::mt19937 rng(11);
+  std::vector<Direction> directions(state.players.size());
+  int depth = 0;
+  while (depth < 64 && !simulator.isGameOver()) {
+    for (auto &direction : directions) {
+      direction = cycles::getDirectionFromValue(rng() % 4);
+    }
+    simulator.make(directions);
+    depth++;
+  }
+  EXPECT_EQ(simulator.getDepth(), depth);
+  while (simulator.getDepth() > 0) {
+    simulator.unmake();
+  }
+  EXPECT_EQ(simulator.getFrame(), state.frameNumber);
+  EXPECT_EQ(simulator.getAliveCount(), int(state.players.size()));
+  expectSameGame(simulator, game, state.players, conf);
+}
+
+TEST(SimulatorTest, ReportsLegalMoves) {
+  auto conf = testConfig(24, 24);
+  Game game(conf);
+  game.addPlayer("player");
+  auto state = snapshot(game, conf);
+  cycles::Simulator simulator(state);
+  auto position = simulator.getPosition(0);
+  std::uint8_t expected = 0;
+  for (int value = 0; value < 4; value++) {
+    auto next = position + cycles::getDirectionVector(cycles::getDirectionFromValue(value));
+    if (state.isInsideGrid(next) && state.isCellEmpty(next)) {
+      expected |= 1 << value;
+    }
+  }
+  EXPECT_EQ(simulator.getLegalMoves(0), expected);
+}
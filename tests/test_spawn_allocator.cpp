@@ -0,0 +1,67 @@
+//GTest tests for the spawn allocator of the server
+#include"server/spawn_allocator.h"
+#include"gtest/gtest.h"
+#include<cstdlib>
+#include<set>
+using cycles_server::SpawnAllocator;
+
+TEST(SpawnAllocatorTest, SpreadsSpawnsApart) {
+  for (int minDistance : {0, 2, 5}) {
+    SpawnAllocator spawns(100, 100, minDistance, 60);
+    EXPECT_GE(spawns.remaining(), 60);
+    std::mt19937 rng(minDistance);
+    std::vector<sf::Vector2i> cells;
+    for (int i = 0; i < 60; i++) {
+      auto cell = spawns.allocate(rng, [](sf::Vector2i) { return true; });
+      ASSERT_TRUE(cell);
+      EXPECT_TRUE(cell->x >= 0 && cell->x < 100 && cell->y >= 0 && cell->y < 100);
+      cells.push_back(*cell);
+    }
+    // The lattice is as coarse as 60 slots allow, whatever the minimum
+    for (std::size_t i = 0; i < cells.size(); i++) {
+      for (std::size_t j = i + 1; j < cells.size(); j++) {
+        auto distance = std::max(std::abs(cells[i].x - cells[j].x),
+                                 std::abs(cells[i].y - cells[j].y));
+        EXPECT_GE(distance, 6);
+      }
+    }
+  }
+}
+
+TEST(SpawnAllocatorTest, KeepsTheMinimumDistanceOnCrowdedGrids) {
+  SpawnAllocator spawns(40, 30, 3, 1000);
+  EXPECT_EQ(spawns.getColumns(), 6);
+  EXPECT_EQ(spawns.getRows(), 5);
+  std::mt19937 rng(7);
+  std::vector<sf::Vector2i> cells;
+  while (auto cell = spawns.allocate(rng, [](sf::Vector2i) { return true; })) {
+    cells.push_back(*cell);
+  }
+  EXPECT_EQ(cells.size(), 30);
+  for (std::size_t i = 0; i < cells.size(); i++) {
+    for (std::size_t j = i + 1; j < cells.size(); j++) {
+      auto distance = std::max(std::abs(cells[i].x - cells[j].x),
+                               std::abs(cells[i].y - cells[j].y));
+      EXPECT_GE(distance, 3);
+    }
+  }
+}
+
+TEST(SpawnAllocatorTest, SkipsOccupiedCellsAndReportsAFullGrid) {
+  SpawnAllocator spawns(20, 20, 5, 4);
+  std::mt19937 rng(3);
+  // Only one free cell per row: each slot still finds one in its middle
+  auto isFree = [](sf::Vector2i cell) { return cell.x == cell.y; };
+  std::set<std::pair<int, int>> cells;
+  for (int i = 0; i < 4; i++) {
+    auto cell = spawns.allocate(rng, isFree);
+    if (cell) {
+      EXPECT_EQ(cell->x, cell->y);
+      cells.insert({cell->x, cell->y});
+    }
+  }
+  // The two slots off the diagonal have no free cell in their middle
+  EXPECT_EQ(cells.size(), 2);
+  EXPECT_EQ(spawns.remaining(), 0);
+  EXPECT_FALSE(spawns.allocate(rng, [](sf::Vector2i) { return true; }));
+}
@@ -0,0 +1,56 @@
+//GTest tests for the frames shared by spectators
+#include"server/spectator_feed.h"
+#include"gtest/gtest.h"
+using namespace cycles_server;
+
+sf::Packet makePacket(sf::Uint16 value) {
+  sf::Packet packet;
+  packet << value;
+  return packet;
+}
+
+TEST(SpectatorFeedTest, SharesOneCopyOfTheFrame) {
+  SpectatorFeed feed;
+  SpectatorFeed::Subscription first(1), second(1);
+  EXPECT_TRUE(feed.pending(first).empty());
+  feed.publish(0, makePacket(0x1234));
+  auto a = feed.pending(first);
+  auto b = feed.pending(second);
+  ASSERT_EQ(a.size(), 6);
+  EXPECT_EQ(a.data(), b.data());
+  EXPECT_EQ(a[3], std::byte(2));
+  EXPECT_EQ(a[5], std::byte(0x34));
+}
+
+TEST(SpectatorFeedTest, FinishesTheFrameBeingWritten) {
+  SpectatorFeed feed;
+  SpectatorFeed::Subscription subscription(1);
+  feed.publish(0, makePacket(0x1234));
+  feed.pending(subscription);
+  subscription.consume(4);
+  // A newer frame does not replace the one halfway out
+  feed.publish(1, makePacket(0x5678));
+  auto pending = feed.pending(subscription);
+  ASSERT_EQ(pending.size(), 2);
+  EXPECT_EQ(pending[0], std::byte(0x12));
+  subscription.consume(2);
+  pending = feed.pending(subscription);
+  ASSERT_EQ(pending.size(), 6);
+  EXPECT_EQ(pending[4], std::byte(0x56));
+  EXPECT_EQ(subscription.getLastFrame(), 1);
+}
+
+TEST(SpectatorFeedTest, SkipsFramesBetweenIntervals) {
+  SpectatorFeed feed;
+  SpectatorFeed::Subscription subscription(3);
+  std::vector<int> received;
+  for (int frame = 0; frame < 10; frame++) {
+    feed.publish(frame, makePacket(frame));
+    auto pending = feed.pending(subscription);
+    if (!pending.empty()) {
+      received.push_back(subscription.getLastFrame());
+      subscription.consume(pending.size());
+    }
+  }
+  EXPECT_EQ(received, (std::vector<int>{0, 3, 6, 9}));
+}
@@ -0,0 +1,92 @@
+//GTest tests for the territory evaluation library
+#include"territory.h"
+#include"gtest/gtest.h"
+#include<queue>
+#include<random>
+using namespace cycles;
+
+GameState makeState(int width, int height, unsigned seed, int players) {
+  GameState state;
+  state.gridWidth = width;
+  state.gridHeight = height;
+  state.frameNumber = 0;
+  state.grid.assign(width * height, 0);
+  std::mt19937 rng(seed);
+  for (auto &cell : state.grid) {
+    cell = rng() % 4 == 0 ? 200 : 0;
+  }
+  for (int p = 0; p < players; p++) {
+    sf::Vector2i position(rng() % width, rng() % height);
+    state.grid[position.y * width + position.x] = p + 1;
+    state.players.push_back(
+        {"p" + std::to_string(p), sf::Color(), position, Id(p + 1), {}});
+  }
+  state.updateOccupancy();
+  return state;
+}
+
+std::vector<int> naiveDistances(const GameState &state, sf::Vector2i source) {
+  std::vector<int> distance(state.grid.size(), -1);
+  std::queue<sf::Vector2i> queue;
+  distance[source.y * state.gridWidth + source.x] = 0;
+  queue.push(source);
+  while (!queue.empty()) {
+    auto cell = queue.front();
+    queue.pop();
+    for (int d = 0; d < 4; d++) {
+      auto next = cell + getDirectionVector(getDirectionFromValue(d));
+      if (!state.isInsideGrid(next) || !state.isCellEmpty(next) ||
+          distance[next.y * state.gridWidth + next.x] >= 0) {
+        continue;
+      }
+      distance[next.y * state.gridWidth + next.x] = distance[cell.y * state.gridWidth + cell.x] + 1;
+      queue.push(next);
+    }
+  }
+  return distance;
+}
+
+TEST(TerritoryTest, FloodFillMatchesNaiveSearch) {
+  // 130 columns make padded rows span three words
+  for (unsigned seed = 0; seed < 5; seed++) {
+    auto state = makeState(130, 40, seed, 3);
+    TerritoryEvaluator evaluator;
+    evaluator.reset(state);
+    for (const auto &player : state.players) {
+      auto expected = naiveDistances(state, player.position);
+      int reachable = std::count_if(expected.begin(), expected.end(), [](int d) { return d > 0; });
+      EXPECT_EQ(evaluator.floodFill(player.position), reachable);
+    }
+  }
+}
+
+TEST(TerritoryTest, DistancesMatchNaiveSearch) {
+  auto state = makeState(70, 50, 42, 1);
+  TerritoryEvaluator evaluator;
+  evaluator.reset(state);
+  const auto source = state.players[0].position;
+  const auto &distances = evaluator.distances(std::span(&source, 1));
+  auto expected = naiveDistances(state, source);
+  for (std::size_t i = 0; i < expected.size(); i++) {
+    const int distance = distances[i] == TerritoryEvaluator::unreachable ? -1 : distances[i];
+    EXPECT_EQ(distance, expected[i]) << i;
+  }
+}
+
+TEST(TerritoryTest, VoronoiSplitsAnEmptyCorridor) {
+  GameState state;
+  state.gridWidth = 9;
+  state.gridHeight = 1;
+  state.grid.assign(9, 0);
+  state.grid[0] = 1;
+  state.grid[6] = 2;
+  state.players.push_back({"a", sf::Color(), {0, 0}, 1, {}});
+  state.players.push_back({"b", sf::Color(), {6, 0}, 2, {}});
+  state.updateOccupancy();
+  TerritoryEvaluator evaluator;
+  evaluator.reset(state);
+  const auto &territory = evaluator.voronoi();
+  // a gets cells 1 and 2, cell 3 is a tie, b gets 4, 5, 7 and 8
+  EXPECT_EQ(territory[0], 2);
+  EXPECT_EQ(territory[1], 4);
+}
@@ -0,0 +1,115 @@
+//GTest tests for the viewports sent in viewport mode
+#include"server/tile_index.h"
+#include"frame_codec.h"
+#include"protocol.h"
+#include"gtest/gtest.h"
+#include<random>
+using cycles::GameState;
+using cycles::Id;
+using namespace cycles_server;
+
+// A grid with long runs, like trails on an empty arena
+std::vector<Id> makeGrid(int width, int height, unsigned int seed) {
+  std::mt19937 rng(seed);
+  std::vector<Id> grid(width * height, 0);
+  for (int trail = 0; trail < 20; trail++) {
+    int x = rng() % width, y = rng() % height;
+    for (int length = 0; length < 100; length++) {
+      grid[y * width + x] = 1 + trail % 5;
+      if (rng() % 2) {
+        x = std::min(width - 1, x + 1);
+      } else {
+        y = std::min(height - 1, y + 1);
+      }
+    }
+  }
+  return grid;
+}
+
+void fill(ChunkedGrid &chunked, const std::vector<Id> &grid) {
+  for (int y = 0; y < chunked.getHeight(); y++) {
+    for (int x = 0; x < chunked.getWidth(); x++) {
+      chunked.set(x, y, grid[y * chunked.getWidth() + x]);
+    }
+  }
+}
+
+// A frame without players around a window of the grid
+GameState decodeWindow(TileIndex &index, const ChunkedGrid &grid,
+                       sf::IntRect window) {
+  sf::Packet packet;
+  packet << sf::Int64(0) << sf::Uint32(0) << grid.getWidth()
+         << grid.getHeight() << sf::Uint32(0);
+  index.writeWindow(packet, window);
+  GameState state;
+  EXPECT_TRUE(cycles::readFrame(packet, state));
+  return state;
+}
+
+TEST(TileIndexTest, WindowsCoverTheRadius) {
+  ChunkedGrid grid(200, 100);
+  TileIndex index(grid);
+  auto window = index.getWindow({100, 50}, 10);
+  EXPECT_EQ(window.left, 64);
+  EXPECT_EQ(window.top, 32);
+  EXPECT_EQ(window.width, 64);
+  EXPECT_EQ(window.height, 32);
+  // Cut at the edges of the grid
+  window = index.getWindow({195, 95}, 40);
+  EXPECT_EQ(window.left, 128);
+  EXPECT_EQ(window.top, 32);
+  EXPECT_EQ(window.width, 72);
+  EXPECT_EQ(window.height, 68);
+}
+
+TEST(TileIndexTest, ClientsDecodeTheirWindow) {
+  const int width = 150, height = 90;
+  auto cells = makeGrid(width, height, 1);
+  ChunkedGrid grid(width, height);
+  fill(grid, cells);
+  TileIndex index(grid);
+  for (auto center : {sf::Vector2i(0, 0), sf::Vector2i(75, 45), sf::Vector2i(149, 89)}) {
+    auto window = index.getWindow(center, 20);
+    auto state = decodeWindow(index, grid, window);
+    EXPECT_EQ(state.windowOffset, sf::Vector2i(window.left, window.top));
+    EXPECT_EQ(state.gridWidth, window.width);
+    EXPECT_EQ(state.gridHeight, window.height);
+    EXPECT_EQ(state.getArenaSize(), sf::Vector2i(width, height));
+    for (int y = window.top; y < window.top + window.height; y++) {
+      for (int x = window.left; x < window.left + window.width; x++) {
+        ASSERT_EQ(state.getGridCell({x, y}), cells[y * width + x]);
+      }
+    }
+  }
+}
+
+TEST(TileIndexTest, ReencodesChangedTiles) {
+  const int width = 128, height = 64;
+  auto cells = makeGrid(width, height, 2);
+  ChunkedGrid grid(width, height);
+  fill(grid, cells);
+  TileIndex index(grid);
+  const auto before = index.getTile(1, 1);
+  // Runs cover the tile exactly
+  int covered = 0;
+  for (std::size_t i = 1; i < before.size(); i += 2) {
+    covered += before[i];
+  }
+  EXPECT_EQ(covered, 32 * 32);
+  grid.set(33, 33, cells[33 * width + 33] == 7 ? 8 : 7);
+  EXPECT_NE(index.getTile(1, 1), before);
+  grid.set(33, 33, cells[33 * width + 33]);
+  EXPECT_EQ(index.getTile(1, 1), before);
+  // Noise takes more room as runs than as cells, so it is sent raw
+  std::mt19937 rng(3);
+  for (auto &cell : cells) {
+    cell = rng() % 2;
+  }
+  fill(grid, cells);
+  auto state = decodeWindow(index, grid, {32, 0, 96, 64});
+  for (int y = 0; y < height; y++) {
+    for (int x = 32; x < width; x++) {
+      ASSERT_EQ(state.getGridCell({x, y}), cells[y * width + x]);
+    }
+  }
+}